@@ -0,0 +1,111 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include "../Network/NetworkNode.h"
+#include "../Network/LossyTransport.h"
+
+#define TRANSFER_SIZE (256 * 1024)
+
+/**
+ * @brief Node exposing the sequence transfer, so both ends of a transfer can run in the same process.
+ */
+class BenchNode: public NetworkNode {
+public:
+    using NetworkNode::NetworkNode;
+
+    void send(const string& data) {
+        this->enqueueLongStringMessageData(MessageType::FILE_DATA, 0, data);
+        this->sendSequence();
+    }
+
+    string receive() {
+        this->receiveSequence();
+        string data = this->getLongStringMessageData();
+        this->popEndMessage();
+        return data;
+    }
+};
+
+/// \brief Transfer TRANSFER_SIZE bytes through a link losing lossRate of the data frames.
+/// \return the goodput in KiB/s, or a negative value if the data was corrupted.
+double measureGoodput(const LinkOptions& options, double lossRate, const string& data, size_t& droppedFrames) {
+    auto transports = SocketTransport::createPair();
+    auto lossy = new LossyTransport(move(transports.first), lossRate, 42);
+    BenchNode sender{unique_ptr<Transport>(lossy)};
+    BenchNode receiver{move(transports.second)};
+
+    sender.setLinkOptions(options);
+    receiver.setLinkOptions(options);
+
+    string received;
+    auto start = chrono::steady_clock::now();
+    thread receiverThread([&]() { received = receiver.receive(); });
+    sender.send(data);
+    receiverThread.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    droppedFrames = lossy->droppedFrames();
+    if (received != data) {
+        return -1;
+    }
+    return data.size() / 1024.0 / seconds;
+}
+
+int main() {
+    Logger::setLevel(LoggerLevel::CRITICAL);
+
+    mt19937 random(7);
+    string data(TRANSFER_SIZE, '\0');
+    for (auto& byte : data) {
+        byte = static_cast<char>(random());
+    }
+
+    cout << "Goodput of a " << TRANSFER_SIZE / 1024 << " KiB transfer over an in-process socket pair." << endl;
+    // Go-back-N is only measured with the default window: with large windows every loss resends so many messages
+    // that a lossy transfer takes minutes.
+    vector<pair<string, LinkOptions>> configurations;
+    configurations.emplace_back("GBN w=4", LinkOptions());
+    for (unsigned long window : {4ul, 64ul, 512ul}) {
+        LinkOptions options;
+        options.arqMode = ArqMode::SELECTIVE_REPEAT;
+        options.windowSize = window;
+        options.extendedHeader = window > MAX_SEQ_COUNT / 2;
+        configurations.emplace_back("SR w=" + to_string(window), options);
+    }
+    // Ethernet and jumbo frames.
+    for (size_t frameSize : {1514ul, 9014ul}) {
+        LinkOptions options;
+        options.arqMode = ArqMode::SELECTIVE_REPEAT;
+        options.windowSize = 64;
+        options.maxFrameSize = frameSize;
+        configurations.emplace_back("SR " + to_string(frameSize) + "B", options);
+    }
+
+    cout << "Goodput (KiB/s) and dropped frames." << endl;
+    cout << setw(8) << "loss";
+    for (const auto& configuration : configurations) {
+        cout << setw(14) << configuration.first << setw(8) << "dropped";
+    }
+    cout << endl;
+
+    for (double lossRate : {0.0, 0.01, 0.02, 0.05, 0.1, 0.2}) {
+        cout << setw(7) << lossRate * 100 << "%";
+        for (const auto& configuration : configurations) {
+            size_t dropped = 0;
+            double goodput = measureGoodput(configuration.second, lossRate, data, dropped);
+            cout << setw(14) << fixed << setprecision(1);
+            if (goodput < 0) {
+                cout << "corrupted";
+            }
+            else {
+                cout << goodput;
+            }
+            cout << setw(8) << dropped;
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
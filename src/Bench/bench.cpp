@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include "../Network/NetworkNode.h"
+
+/// \brief Each case runs for about this long, after a short warm up.
+#define BENCH_DURATION chrono::milliseconds(300)
+#define BENCH_WARMUP_ITERATIONS 16
+/// \brief Calls timed together when there is no setup, so reading the clock doesn't dominate short operations.
+#define BENCH_BATCH_SIZE 256
+#define LONG_STRING_SIZE (1024 * 1024)
+#define REORDER_WINDOW_SIZE 64
+
+/// \brief Heap allocations made by the whole process, counted by the replaced operator new.
+static atomic<size_t> allocations(0);
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    void *pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+/// \brief Keeps the compiler from dropping the work being measured.
+static volatile size_t sink;
+
+/**
+ * @brief Time operation, running setup before each batch of calls without measuring it, and print a line with the
+ * time, throughput and allocations of each call.
+ * @param bytes Bytes handled by each call, 0 if the throughput doesn't apply.
+ * @param batchSize Calls of operation after each setup.
+ */
+template<typename Setup, typename Operation>
+void run(const string& name, size_t bytes, size_t batchSize, Setup setup, Operation operation) {
+    for (size_t i = 0; i < BENCH_WARMUP_ITERATIONS; i++) {
+        setup();
+        operation();
+    }
+
+    size_t iterations = 0;
+    size_t allocated = 0;
+    chrono::nanoseconds elapsed(0);
+    while (elapsed < BENCH_DURATION) {
+        setup();
+        size_t allocationsBefore = allocations.load(memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < batchSize; i++) {
+            operation();
+        }
+        elapsed += chrono::steady_clock::now() - start;
+        allocated += allocations.load(memory_order_relaxed) - allocationsBefore;
+        iterations += batchSize;
+    }
+
+    double nanoseconds = static_cast<double>(elapsed.count()) / iterations;
+    cout << left << setw(50) << name << right << setw(10) << iterations << fixed << setprecision(1)
+         << setw(14) << nanoseconds;
+    if (bytes > 0) {
+        cout << setw(12) << bytes / nanoseconds * 1e9 / (1024 * 1024);
+    }
+    else {
+        cout << setw(12) << "-";
+    }
+    cout << setw(12) << setprecision(2) << static_cast<double>(allocated) / iterations << endl;
+}
+
+/// \brief Operation that must be prepared before every call.
+template<typename Setup, typename Operation>
+void run(const string& name, size_t bytes, Setup setup, Operation operation) {
+    run(name, bytes, 1, setup, operation);
+}
+
+/// \brief Operation without setup.
+template<typename Operation>
+void run(const string& name, size_t bytes, Operation operation) {
+    run(name, bytes, BENCH_BATCH_SIZE, [] {}, operation);
+}
+
+/**
+ * @brief Node exposing the receive buffers, so the reassembly of messages can be measured without a peer.
+ */
+class BenchNode: public NetworkNode {
+public:
+    using NetworkNode::NetworkNode;
+
+    vector<Message>& receivedBuffer() { return this->m_receivedBuffer; }
+    queue<Message>& receivedQueue() { return this->m_receivedQueue; }
+    unsigned long reorder(unsigned long startSeq) { return this->handleReceivedBuffer(startSeq); }
+    string reassemble() { return this->getLongStringMessageData(); }
+};
+
+/// \brief Messages carrying data, with size bytes of data each.
+vector<Message> makeMessages(size_t count, size_t size, bool extended) {
+    vector<Message> messages;
+    vector<C_BYTE> data(size);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < size; j++) {
+            data[j] = static_cast<C_BYTE>(i + j);
+        }
+        messages.emplace_back(MessageType::FILE_DATA, i, data.data(), data.size());
+        messages.back().setExtended(extended);
+    }
+    return messages;
+}
+
+void benchMessage() {
+    for (size_t size : {MAX_DATA_SIZE, 1500ul}) {
+        bool extended = size > MAX_DATA_SIZE;
+        string suffix = " (" + to_string(size) + " B)";
+        vector<C_BYTE> data(size, 0x5A);
+
+        run("Message(type, seq, data, size)" + suffix, size, [&] {
+            Message message(MessageType::FILE_DATA, 1, data.data(), data.size());
+            sink = message.getSize();
+        });
+        run("Message(type, seq, vector&&)" + suffix, size, [&] {
+            Message message(MessageType::FILE_DATA, 1, vector<C_BYTE>(data));
+            sink = message.getSize();
+        });
+
+        Message message(MessageType::FILE_DATA, 1, data.data(), data.size());
+        message.setExtended(extended);
+        run("Message::toCharVector" + suffix, size, [&] {
+            sink = message.toCharVector().size();
+        });
+        vector<C_BYTE> frame(message.getFrameSize());
+        run("Message::encode" + suffix, size, [&] {
+            sink = message.encode(frame.data(), frame.size());
+        });
+        run("Message(bytes, size)" + suffix, size, [&] {
+            Message decoded(frame.data(), frame.size());
+            sink = decoded.getSize();
+        });
+    }
+
+    mt19937 random(7);
+    string text(LONG_STRING_SIZE, '\0');
+    for (auto& byte : text) {
+        byte = static_cast<char>(random());
+    }
+    for (size_t dataSize : {MAX_DATA_SIZE, 1500ul}) {
+        run("Message::fromLongString (1 MiB, " + to_string(dataSize) + " B messages)", text.size(), [&] {
+            sink = Message::fromLongString(MessageType::FILE_DATA, 0, text, dataSize).size();
+        });
+    }
+}
+
+void benchNetworkNode() {
+    auto transports = SocketTransport::createPair();
+    BenchNode node{move(transports.first)};
+    LinkOptions options;
+    options.extendedHeader = true;
+    options.windowSize = REORDER_WINDOW_SIZE;
+    node.setLinkOptions(options);
+
+    // A window received in a random order, starting at a sequence id that wraps around inside it.
+    unsigned long startSeq = EXTENDED_MAX_SEQ - REORDER_WINDOW_SIZE / 2;
+    vector<Message> window;
+    for (auto& message : makeMessages(REORDER_WINDOW_SIZE, MAX_DATA_SIZE, true)) {
+        window.emplace_back(MessageType::FILE_DATA, (startSeq + message.getSequenceId()) % EXTENDED_MAX_SEQ_COUNT,
+                            message.getDataBytes(), message.getDataSize());
+        window.back().setExtended(true);
+    }
+    shuffle(window.begin(), window.end(), mt19937(7));
+    run("handleReceivedBuffer (" + to_string(REORDER_WINDOW_SIZE) + " shuffled messages)",
+        REORDER_WINDOW_SIZE * MAX_DATA_SIZE, [&] {
+            node.receivedBuffer().assign(window.begin(), window.end());
+            queue<Message>().swap(node.receivedQueue());
+        }, [&] {
+            sink = node.reorder(startSeq);
+        });
+
+    vector<Message> sequence = makeMessages(LONG_STRING_SIZE / MAX_DATA_SIZE, MAX_DATA_SIZE, false);
+    sequence.emplace_back(MessageType::END, sequence.size());
+    run("getLongStringMessageData (1 MiB)", (sequence.size() - 1) * MAX_DATA_SIZE, [&] {
+            queue<Message> received;
+            for (const auto& message : sequence) {
+                received.push(message);
+            }
+            node.receivedQueue().swap(received);
+        }, [&] {
+            sink = node.reassemble().size();
+        });
+}
+
+int main() {
+    Logger::setLevel(LoggerLevel::CRITICAL);
+    NetworkNode::message_delimiter = BEGIN_DELIMITER;
+
+    cout << left << setw(50) << "benchmark" << right << setw(10) << "calls" << setw(14) << "ns/op"
+         << setw(12) << "MiB/s" << setw(12) << "allocs/op" << endl;
+    benchMessage();
+    benchNetworkNode();
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include "../Message/Crc32c.h"
+#include "../Network/NetworkNode.h"
+
+#define CODEC_ITERATIONS 1000000
+/// \brief Large payloads are encoded fewer times, so each configuration moves about the same amount of memory.
+#define CODEC_BYTES (CODEC_ITERATIONS * 64ul)
+
+/// \brief Keeps the compiler from dropping the work being measured.
+static volatile size_t sink;
+
+/// \brief Run operation iterations times.
+/// \return The number of operations per second.
+template<typename Operation>
+double measureRate(size_t iterations, Operation operation) {
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        operation(i);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return iterations / seconds;
+}
+
+int main() {
+    Logger::setLevel(LoggerLevel::CRITICAL);
+    NetworkNode::message_delimiter = BEGIN_DELIMITER;
+
+    cout << "Message codec throughput, in millions of frames per second." << endl;
+    cout << setw(10) << "data" << setw(10) << "header" << setw(14) << "toCharVector" << setw(10) << "encode"
+         << setw(10) << "decode" << setw(10) << "copy" << endl;
+
+    // Data size and whether the message ends with a CRC-32C, large messages need the extended header.
+    vector<pair<size_t, bool>> configurations = {{0, false}, {MAX_DATA_SIZE, false}, {MAX_DATA_SIZE, true},
+                                                 {1500, false}, {1500, true}, {9000, false}, {9000, true}};
+    for (const auto& configuration : configurations) {
+        size_t dataSize = configuration.first;
+        bool crc = configuration.second;
+        bool extended = dataSize > MAX_DATA_SIZE || crc;
+        size_t iterations = min(static_cast<size_t>(CODEC_ITERATIONS), CODEC_BYTES / max(dataSize, MIN_FRAME_SIZE));
+
+        vector<C_BYTE> data(dataSize);
+        for (size_t i = 0; i < dataSize; i++) {
+            data[i] = static_cast<C_BYTE>(i * 31);
+        }
+        Message message(MessageType::FILE_DATA, 0, move(data));
+        message.setExtended(extended, crc);
+        vector<C_BYTE> frame = message.toCharVector();
+
+        double toCharVector = measureRate(iterations, [&](size_t) {
+            sink = message.toCharVector().size();
+        });
+        vector<C_BYTE> buffer(frame.size());
+        double encode = measureRate(iterations, [&](size_t) {
+            sink = message.encode(buffer.data(), buffer.size());
+        });
+        double decode = measureRate(iterations, [&](size_t) {
+            Message decoded(frame.data(), frame.size());
+            sink = decoded.getSize();
+        });
+        // Messages are copied in and out of the send queue and the receive buffers.
+        double copy = measureRate(iterations, [&](size_t i) {
+            Message copied(message);
+            sink = copied.getSequenceId() + i;
+        });
+
+        cout << setw(10) << dataSize << setw(10) << (crc ? "crc" : extended ? "extended" : "normal")
+             << fixed << setprecision(2)
+             << setw(14) << toCharVector / 1e6 << setw(10) << encode / 1e6 << setw(10) << decode / 1e6
+             << setw(10) << copy / 1e6 << endl;
+    }
+
+    vector<C_BYTE> block(1 << 20);
+    for (size_t i = 0; i < block.size(); i++) {
+        block[i] = static_cast<C_BYTE>(i * 31);
+    }
+    double hardware = measureRate(1000, [&](size_t) { sink = crc32c(block.data(), block.size()); });
+    double software = measureRate(200, [&](size_t) { sink = crc32cSoftware(block.data(), block.size()); });
+    cout << endl << "CRC-32C throughput (GB/s): " << setprecision(2)
+         << (crc32cHardwareSupported() ? "sse4.2 " : "dispatch (no sse4.2) ") << hardware * block.size() / 1e9
+         << ", slice-by-8 " << software * block.size() / 1e9 << endl;
+
+    return 0;
+}
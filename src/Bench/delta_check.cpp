@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include "../FileHandler/FileDelta.h"
+#include "../Logger/Logger.h"
+
+/// \brief Size of the old version of the file in most cases, large enough for a few hundred blocks.
+#define CHECK_FILE_SIZE static_cast<size_t>(1024 * 1024)
+
+/// \brief An old and a new version of a file.
+struct DeltaCase {
+    const char *name;
+    vector<char> basis;
+    vector<char> modified;
+};
+
+static vector<char> randomBytes(mt19937& random, size_t size) {
+    vector<char> data(size);
+    for (char& byte : data) {
+        byte = static_cast<char>(random());
+    }
+    return data;
+}
+
+static void writeFile(const string& path, const vector<char>& data) {
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(data.data(), static_cast<streamsize>(data.size()));
+}
+
+static vector<char> readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+/// \brief Everything a producer hands out, read in chunks as NetworkNode does.
+static vector<unsigned char> readAll(ByteProducer& producer) {
+    vector<unsigned char> bytes;
+    char buffer[4096];
+    size_t count;
+    while ((count = producer.read(buffer, sizeof(buffer))) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+    return bytes;
+}
+
+/// \brief Encode the new version against the signatures of the old one, then rebuild it from the old one with the
+/// instructions delivered in chunks of deliverySize bytes.
+/// \return true if the rebuilt file is the new version.
+static bool roundTrip(const string& directory, const DeltaCase& test, size_t deliverySize, size_t& deltaSize) {
+    string basisPath = directory + "/basis", modifiedPath = directory + "/modified", outputPath = directory + "/output";
+    writeFile(basisPath, test.basis);
+    writeFile(modifiedPath, test.modified);
+    remove(outputPath.c_str());
+
+    size_t blockSize = deltaBlockSize(test.basis.size());
+    SignatureWriter signatureWriter(basisPath, blockSize);
+    vector<unsigned char> signatures = readAll(signatureWriter);
+    DeltaEncoder encoder(modifiedPath, signatures);
+    if (!encoder.isOpen()) {
+        return false;
+    }
+    vector<unsigned char> delta = readAll(encoder);
+    deltaSize = delta.size();
+
+    bool result;
+    {
+        DeltaDecoder decoder(basisPath, blockSize, outputPath);
+        result = true;
+        for (size_t i = 0; i < delta.size() && result; i += deliverySize) {
+            result = decoder.write(delta.data() + i, min(deliverySize, delta.size() - i));
+        }
+        result = decoder.finish() && result;
+    }
+    return result && readFile(outputPath) == test.modified;
+}
+
+int main() {
+    Logger::setLevel(LoggerLevel::CRITICAL);
+
+    char directoryTemplate[] = "/tmp/delta_checkXXXXXX";
+    if (mkdtemp(directoryTemplate) == nullptr) {
+        cerr << "Could not create a temporary directory." << endl;
+        return 1;
+    }
+    string directory = directoryTemplate;
+
+    mt19937 random(42);
+    vector<char> basis = randomBytes(random, CHECK_FILE_SIZE);
+    auto edit = [&basis](function<void(vector<char>&)> change) {
+        vector<char> modified = basis;
+        change(modified);
+        return modified;
+    };
+    vector<char> inserted = randomBytes(random, 1000);
+    vector<char> shortBasis = randomBytes(random, 1000);
+    vector<char> zeros(200 * 1024, 0);
+
+    vector<DeltaCase> cases = {
+            {"unchanged", basis, basis},
+            {"insertion", basis, edit([&](vector<char>& data) {
+                data.insert(data.begin() + 300001, inserted.begin(), inserted.end());
+            })},
+            {"deletion", basis, edit([](vector<char>& data) {
+                data.erase(data.begin() + 123457, data.begin() + 128457);
+            })},
+            {"insert at start, delete at end", basis, edit([&](vector<char>& data) {
+                data.insert(data.begin(), inserted.begin(), inserted.end());
+                data.resize(data.size() - 7777);
+            })},
+            {"append", basis, edit([&](vector<char>& data) {
+                data.insert(data.end(), inserted.begin(), inserted.end());
+            })},
+            {"bytes changed", basis, edit([](vector<char>& data) {
+                for (size_t i = 777; i < data.size(); i += 65536) {
+                    data[i] = static_cast<char>(~data[i]);
+                }
+            })},
+            {"shorter than a block", shortBasis, [&shortBasis] {
+                vector<char> data = shortBasis;
+                data[500] = static_cast<char>(~data[500]);
+                return data;
+            }()},
+            {"short basis, long file", shortBasis, edit([&](vector<char>& data) {
+                data.insert(data.begin() + 4096, shortBasis.begin(), shortBasis.end());
+            })},
+            {"emptied", basis, {}},
+            {"empty basis", {}, basis},
+            {"unrelated", basis, randomBytes(random, CHECK_FILE_SIZE / 2)},
+            {"repeated blocks", zeros, [&zeros] {
+                vector<char> data = zeros;
+                data[100000] = 1;
+                data.insert(data.begin() + 5000, 3, 2);
+                return data;
+            }()},
+    };
+
+    cout << "Round trip of DeltaEncoder and DeltaDecoder, with the instructions delivered in chunks of 1, 7 and 65536"
+         << " bytes." << endl;
+    cout << setw(32) << "case" << setw(10) << "basis" << setw(10) << "file" << setw(10) << "delta"
+         << setw(8) << "1" << setw(8) << "7" << setw(8) << "65536" << endl;
+    bool passed = true;
+    for (const DeltaCase& test : cases) {
+        size_t deltaSize = 0;
+        cout << setw(32) << test.name << setw(10) << test.basis.size() << setw(10) << test.modified.size();
+        string results;
+        for (size_t deliverySize : {static_cast<size_t>(1), static_cast<size_t>(7), static_cast<size_t>(65536)}) {
+            bool result = roundTrip(directory, test, deliverySize, deltaSize);
+            passed = passed && result;
+            results += string(4, ' ') + (result ? "  ok" : "FAIL");
+        }
+        cout << setw(10) << deltaSize << results << endl;
+    }
+
+    for (const char *name : {"/basis", "/modified", "/output"}) {
+        remove((directory + name).c_str());
+    }
+    rmdir(directory.c_str());
+
+    cout << (passed ? "All round trips rebuilt the file." : "Some round trips failed.") << endl;
+    return passed ? 0 : 1;
+}
@@ -1,6 +1,10 @@
 #include "Client.h"
+#include "../FileHandler/DirectoryListing.h"
 #include "../FileHandler/fileHandler.h"
 #include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <sstream>
 
 std::string Client::execBashCmd(const string &command) {
     logger->info("Executing bash command: " + command);
@@ -22,9 +26,9 @@ std::string Client::execBashCmd(const string &command) {
     return result;
 }
 
-void Client::requestLocalLS() {
+void Client::requestLocalLS(istream& arguments) {
     string lsText;
-    getline(cin, lsText);
+    getline(arguments, lsText);
 
     try {
         cout << execBashCmd("ls " + lsText);
@@ -33,9 +37,9 @@ void Client::requestLocalLS() {
     }
 }
 
-void Client::requestLocalMkdir() {
+void Client::requestLocalMkdir(istream& arguments) {
     string mkdirText;
-    getline(cin, mkdirText);
+    getline(arguments, mkdirText);
 
     try {
         cout << execBashCmd("mkdir " + mkdirText);
@@ -47,7 +51,12 @@ void Client::requestLocalMkdir() {
 bool Client::handleLS_SHOW() {
     logger->info("Handling a LS message.");
 
-    cout << this->getLongStringMessageData();
+    try {
+        cout << this->getLongStringMessageData();
+    } catch (runtime_error& e) {
+        cerr << e.what() << endl;
+        return false;
+    }
 
     return true;
 }
@@ -68,55 +77,187 @@ bool Client::handleError() {
     return false;
 }
 
+Client::~Client() {
+    this->waitBackground();
+}
+
 bool Client::waitCommand() {
     cout << "Entre um comando:" << endl;
-    string command;
-    while (cin >> command && command != "exit") {
-
-        if (command == "ls") {
-            this->requestLS();
-        }
-        else if (command == "cd") {
-            this->requestCD();
+    string line;
+    while (getline(cin, line)) {
+        size_t last = line.find_last_not_of(" \t");
+        bool background = last != string::npos && line[last] == '&';
+        if (background) {
+            line.erase(last);
         }
-        else if (command == "mkdir") {
-            this->requestMkdir();
-        }
-        else if (command == "put") {
-            this->requestPUT();
+
+        istringstream arguments(line);
+        string command;
+        if (!(arguments >> command)) {
+            continue;
         }
-        else if (command == "get") {
-            this->requestGET();
+        if (command == "exit") {
+            break;
         }
-        else if (command == "lls") {
-            requestLocalLS();
+        if (command == "wait") {
+            this->waitBackground();
+            continue;
         }
-        else if (command == "lmkdir") {
-            requestLocalMkdir();
+
+        if (background && this->m_channels != nullptr) {
+            string rest;
+            getline(arguments, rest);
+            this->runInBackground(command, rest);
         }
         else {
-            cout << "Comando invalido." << endl;
+            if (background) {
+                cerr << "Background commands need a multiplexed link (--channels), running it now." << endl;
+            }
+            this->runCommand(command, arguments);
         }
     }
 
+    this->waitBackground();
     return true;
 }
 
-bool Client::requestLS() {
+void Client::runCommand(const string &command, istream &arguments) {
+    if (command == "ls") {
+        this->requestLS(arguments);
+    }
+    else if (command == "cd") {
+        this->requestCD(arguments);
+    }
+    else if (command == "mkdir") {
+        this->requestMkdir(arguments);
+    }
+    else if (command == "put") {
+        this->requestPUT(arguments);
+    }
+    else if (command == "get") {
+        this->requestGET(arguments);
+    }
+    else if (command == "dput") {
+        this->requestDPUT(arguments);
+    }
+    else if (command == "dget") {
+        this->requestDGET(arguments);
+    }
+    else if (command == "mput") {
+        this->requestMPUT(arguments);
+    }
+    else if (command == "mget") {
+        this->requestMGET(arguments);
+    }
+    else if (command == "lls") {
+        requestLocalLS(arguments);
+    }
+    else if (command == "lmkdir") {
+        requestLocalMkdir(arguments);
+    }
+    else {
+        cout << "Comando invalido." << endl;
+    }
+}
+
+void Client::runInBackground(const string &command, const string &arguments) {
+    unique_ptr<Client> worker = this->takeWorker();
+    if (!worker) {
+        cerr << "Too many commands running in the background." << endl;
+        return;
+    }
+
+    lock_guard<mutex> lock(this->m_backgroundMutex);
+    this->m_background.emplace_back([this, command, arguments](unique_ptr<Client> worker) {
+        if (!this->prepareWorker(*worker)) {
+            cerr << "Could not open a channel for " << command << "." << endl;
+            return;
+        }
+
+        istringstream stream(arguments);
+        worker->runCommand(command, stream);
+        this->releaseWorker(move(worker));
+    }, move(worker));
+}
+
+unique_ptr<Client> Client::takeWorker() {
+    {
+        lock_guard<mutex> lock(this->m_backgroundMutex);
+        if (!this->m_idleWorkers.empty()) {
+            unique_ptr<Client> worker = move(this->m_idleWorkers.back());
+            this->m_idleWorkers.pop_back();
+            return worker;
+        }
+    }
+
+    // Channel 0 is the one of the prompt, the others may be used by workers still running.
+    unique_ptr<Transport> channel;
+    for (unsigned id = 1; id < MAX_CHANNELS && !channel; id++) {
+        channel = this->m_channels->open(static_cast<C_BYTE>(id));
+    }
+    if (!channel) {
+        return nullptr;
+    }
+    unique_ptr<Client> worker(new Client(move(channel)));
+    // A background mget can also spread its files over channels of their own.
+    worker->setChannels(this->m_channels);
+    worker->setParallelTransfers(this->m_parallelTransfers);
+    return worker;
+}
+
+bool Client::prepareWorker(Client &worker) {
+    // The server of a new channel starts with the default options, like the one of a new link.
+    if (!worker.m_ready) {
+        worker.m_ready = worker.negotiate(this->getLinkOptions());
+    }
+    return worker.m_ready;
+}
+
+void Client::releaseWorker(unique_ptr<Client> worker) {
+    lock_guard<mutex> lock(this->m_backgroundMutex);
+    this->m_idleWorkers.push_back(move(worker));
+}
+
+void Client::waitBackground() {
+    vector<thread> running;
+    {
+        lock_guard<mutex> lock(this->m_backgroundMutex);
+        running.swap(this->m_background);
+    }
+    for (auto& job : running) {
+        job.join();
+    }
+}
+
+bool Client::requestLS(istream& arguments) {
     std::string dirPath;
-    getline(cin, dirPath);
+    getline(arguments, dirPath);
 
     this->enqueueLongStringMessageData(MessageType::LS, 0, dirPath);
     this->sendSequence();
 
-    bool executionResult = this->waitSequence();
+    // The entries are shown as they arrive, while the server is still reading the directory.
+    DirectoryListingParser parser([](const DirectoryEntry& entry, unsigned flags) {
+        cout << formatEntry(entry, (flags & LIST_LONG) != 0) << '\n';
+    });
+    this->receiveStream(MessageType::LS_SHOW, [&parser](const C_BYTE *data, size_t size) {
+        return parser.write(data, size);
+    });
+    this->waitSequence(false);
+    this->receiveStream(MessageType::INVALID, nullptr);
+    cout.flush();
 
-    return executionResult;
+    if (this->m_receivedQueue.front().getType() == MessageType::ERROR) {
+        return this->handleError();
+    }
+    this->popEndMessage();
+    return true;
 }
 
-bool Client::requestMkdir() {
+bool Client::requestMkdir(istream& arguments) {
+    // The whole line, with -p and several directories.
     std::string dirPath;
-    cin >> dirPath;
+    getline(arguments, dirPath);
 
     this->enqueueLongStringMessageData(MessageType::MKDIR, 0, dirPath);
     this->sendSequence();
@@ -126,9 +267,9 @@ bool Client::requestMkdir() {
     return executionResult;
 }
 
-void Client::requestCD() {
+void Client::requestCD(istream& arguments) {
     string dirPath;
-    cin >> dirPath;
+    arguments >> dirPath;
 
     this->enqueueLongStringMessageData(MessageType::CD, 0, dirPath);
     this->sendSequence();
@@ -136,13 +277,24 @@ void Client::requestCD() {
     this->waitSequence();
 }
 
-void Client::requestPUT() {
+void Client::requestPUT(istream& arguments) {
     std::string filePath, writePath;
-    cin >> filePath >> writePath;
+    arguments >> filePath >> writePath;
+
+    this->putFile(filePath, writePath);
+}
 
+void Client::requestDPUT(istream& arguments) {
+    std::string filePath, writePath;
+    arguments >> filePath >> writePath;
+
+    this->putFile(filePath, writePath, true);
+}
+
+bool Client::putFile(const string &filePath, const string &writePath, bool delta) {
     if (!fileExists(filePath)) {
         cerr << "Put error: " << filePath << " file does not exist." << endl;
-        return;
+        return false;
     }
 
     this->enqueueLongStringMessageData(MessageType::PUT, 0, writePath);
@@ -150,7 +302,7 @@ void Client::requestPUT() {
     logger->debug("Waiting answer.");
     bool result = this->waitSequence();
     if (!result) {
-        return;
+        return false;
     }
 
     logger->debug("Preparing file descriptor.");
@@ -159,32 +311,61 @@ void Client::requestPUT() {
                                    vector<C_BYTE>(fileName.begin(), fileName.end()));
     size_t fileSize = getFileSize(filePath);
     this->m_sendQueue.emplace_back(MessageType::FILE_DESCRIPTOR, 1, fileSize);
-    this->m_sendQueue.emplace_back(MessageType::END, 2);
+    // A server with a chunk store only asks for the chunks it doesn't have yet.
+    unsigned long flags = FILE_DESCRIPTOR_CHUNKS | (delta ? FILE_DESCRIPTOR_DELTA : 0);
+    this->m_sendQueue.emplace_back(MessageType::FILE_DESCRIPTOR, 2, flags);
+    this->m_sendQueue.emplace_back(MessageType::END, 3);
     this->sendSequence();
-    result = this->waitSequence();
-    if (!result) {
-        return;
+    // The server asks for what its checkpoint is missing if an earlier put of the file was interrupted, for a delta if
+    // it has a copy of the file, or for the list of chunks of the file.
+    unsigned long start, length;
+    if (!this->waitFileAccepted(start, length)) {
+        return false;
     }
 
-    logger->debug("Reading file: " + filePath);
-    string fileData = readFile(filePath);
-    this->enqueueLongStringMessageData(MessageType::FILE_DATA, 0, fileData);
-    logger->info("Messages to send: " + to_string(this->m_sendQueue.size()));
+    logger->debug("Streaming file: " + filePath);
+    if (!this->enqueueFile(MessageType::FILE_DATA, 0, filePath, start, length)) {
+        // The descriptor was already accepted, so the other node still waits for the data.
+        logger->error("Could not open file: " + filePath);
+        this->enqueueLongStringMessageData(MessageType::FILE_DATA, 0, "");
+    }
+    if (start > 0) {
+        cout << "Resuming " << filePath << " from byte " << start << "." << endl;
+    }
+    logger->info("Bytes to send: " + to_string(min(length, fileSize - min(start, fileSize))));
     this->sendSequence();
     result = this->waitSequence();
 
     if (result) {
         cout << "File sent successfully." << endl;
     }
+    return result;
 }
 
-void Client::requestGET() {
+void Client::requestGET(istream& arguments) {
     std::string filePath, writePath;
-    cin >> filePath >> writePath;
+    arguments >> filePath >> writePath;
+    // An optional range, to get only a slice of the file.
+    unsigned long start = 0, length = numeric_limits<unsigned long>::max();
+    if (arguments >> start && !(arguments >> length)) {
+        length = numeric_limits<unsigned long>::max();
+    }
+
+    this->getFile(filePath, writePath, start, length);
+}
 
+void Client::requestDGET(istream& arguments) {
+    std::string filePath, writePath;
+    arguments >> filePath >> writePath;
+
+    this->getFile(filePath, writePath, 0, numeric_limits<unsigned long>::max(), true);
+}
+
+bool Client::getFile(const string &filePath, const string &writePath, unsigned long start, unsigned long length,
+                     bool delta) {
     if (!hasWritePermission(writePath)) {
         cerr << "The current user doesn't have write permission in " << writePath << endl;
-        return;
+        return false;
     }
 
     this->enqueueLongStringMessageData(MessageType::GET, 0, filePath);
@@ -192,9 +373,12 @@ void Client::requestGET() {
     logger->debug("next");
 
     this->waitSequence(false);
+    if (this->m_receivedQueue.front().getType() == MessageType::ERROR) {
+        return this->handleError();
+    }
     string fileName;
     try {
-        fileName = this->handleFileDescriptor(writePath);
+        fileName = this->handleFileDescriptor(writePath, start, length, delta);
     }
     catch (runtime_error& e) {
         cerr << e.what() << endl;
@@ -202,16 +386,125 @@ void Client::requestGET() {
         this->enqueueLongStringMessageData(MessageType::ERROR, 0, e.what());
         this->sendSequence();
         logger->debug(to_string(this->m_receivedQueue.size()));
+        return false;
+    }
+
+    if (this->m_checkpoint.done > 0) {
+        cout << "Resuming " << fileName << " after " << this->m_checkpoint.done << " bytes." << endl;
+    }
+    this->acceptFile();
+
+    bool result = this->handleFileData(writePath + "/" + fileName);
+    this->popEndMessage();
+
+    if (result) {
+        cout << "File received successfully." << endl;
+    }
+    return result;
+}
+
+void Client::requestMPUT(istream& arguments) {
+    vector<string> patterns{istream_iterator<string>(arguments), istream_iterator<string>()};
+    if (patterns.size() < 2) {
+        cerr << "Usage: mput <files or patterns...> <remote directory>" << endl;
         return;
     }
+    string writePath = patterns.back();
+    patterns.pop_back();
+
+    vector<string> files;
+    for (const string& pattern : patterns) {
+        vector<string> matched = matchFiles(pattern);
+        if (matched.empty()) {
+            cerr << "Put error: no file matches " << pattern << endl;
+        }
+        files.insert(files.end(), matched.begin(), matched.end());
+    }
+    this->transferFiles(true, files, writePath);
+}
+
+void Client::requestMGET(istream& arguments) {
+    vector<string> patterns{istream_iterator<string>(arguments), istream_iterator<string>()};
+    if (patterns.size() < 2) {
+        cerr << "Usage: mget <files or patterns...> <local directory>" << endl;
+        return;
+    }
+    string writePath = patterns.back();
+    patterns.pop_back();
 
-    this->m_sendQueue.emplace_back(MessageType::OK, 0);
-    this->m_sendQueue.emplace_back(MessageType::END, 1);
+    if (!hasWritePermission(writePath)) {
+        cerr << "The current user doesn't have write permission in " << writePath << endl;
+        return;
+    }
+
+    // The patterns are expanded by the server, relative to its current directory.
+    string patternList;
+    for (const string& pattern : patterns) {
+        patternList += pattern + "\n";
+    }
+    this->enqueueLongStringMessageData(MessageType::GLOB, 0, patternList);
     this->sendSequence();
 
     this->waitSequence(false);
-    this->handleFileData(writePath + "/" + fileName);
+    if (this->m_receivedQueue.front().getType() == MessageType::ERROR) {
+        this->handleError();
+        return;
+    }
+    istringstream listing;
+    try {
+        listing.str(this->getLongStringMessageData());
+    } catch (runtime_error& e) {
+        // An empty list would look like no file matched.
+        cerr << "Could not read the files matching the patterns: " << e.what() << endl;
+        this->popEndMessage();
+        return;
+    }
     this->popEndMessage();
 
-    cout << "File received successfully." << endl;
+    vector<string> files;
+    string file;
+    while (getline(listing, file)) {
+        files.push_back(file);
+    }
+    this->transferFiles(false, files, writePath);
+}
+
+void Client::transferFiles(bool upload, const vector<string> &files, const string &destination) {
+    atomic<size_t> next{0};
+    atomic<size_t> transferred{0};
+    auto transferNext = [&](Client& client) {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            if (upload ? client.putFile(files[i], destination) : client.getFile(files[i], destination)) {
+                transferred++;
+            }
+        }
+    };
+
+    // Each stream is a worker on a channel of its own, taking the next file once it is done with one.
+    vector<thread> streams;
+    for (size_t i = 0; this->m_channels != nullptr && i < min(this->m_parallelTransfers, files.size()); i++) {
+        unique_ptr<Client> worker = this->takeWorker();
+        if (!worker) {
+            break;
+        }
+        streams.emplace_back([this, &transferNext](unique_ptr<Client> worker) {
+            if (this->prepareWorker(*worker)) {
+                transferNext(*worker);
+            }
+            this->releaseWorker(move(worker));
+        }, move(worker));
+    }
+    if (streams.empty()) {
+        transferNext(*this);
+    }
+    for (auto& stream : streams) {
+        stream.join();
+    }
+    // Workers that couldn't negotiate the options of their channel take no file.
+    if (next < files.size()) {
+        cerr << "Could not negotiate the options of the transfer channels, moving the files one at a time." << endl;
+        transferNext(*this);
+    }
+
+    cout << transferred << " of " << files.size() << " files " << (upload ? "sent." : "received.") << endl;
 }
@@ -2,8 +2,14 @@
 #define REDES_1_T1_CLIENT_H
 
 
+#include <mutex>
+#include <thread>
+#include "../Network/ChannelMux.h"
 #include "../Network/NetworkNode.h"
 
+/// \brief Files moved at once by mget and mput on a multiplexed link.
+#define DEFAULT_PARALLEL_TRANSFERS 4
+
 /**
  * @brief Represent the client side of the network connection, sending messages to a bash server.
  */
@@ -11,9 +17,19 @@ class Client: public NetworkNode {
     using NetworkNode::NetworkNode;
 
 public:
-    /// \brief Wait for a new command to be inputted by the user.
+    /// \brief Wait for all the background commands to finish.
+    ~Client() override;
+
+    /// \brief Wait for a new command to be inputted by the user. A command ending with '&' runs in the background,
+    /// on a channel of its own, if the link is multiplexed.
     bool waitCommand();
 
+    /// \brief Run the commands ending with '&' on other channels of mux, each by a worker client of its own.
+    void setChannels(ChannelMux *mux) { m_channels = mux; }
+    /// \brief Move up to count files at once in mget and mput, each on a channel of its own. Only used on a
+    /// multiplexed link.
+    void setParallelTransfers(size_t count) { m_parallelTransfers = max(count, static_cast<size_t>(1)); }
+
 protected:
     /// \brief Show the user the result of a LS command execution.
     /// \return true if the execution was successfull, false otherwise.
@@ -31,26 +47,74 @@ protected:
     std::string execBashCmd(const string &command);
 
 private:
+    /// \brief Run a command, reading its arguments from the given stream.
+    void runCommand(const string& command, istream& arguments);
+    /// \brief Run a command on a worker client, in a thread of its own.
+    void runInBackground(const string& command, const string& arguments);
+    /// \brief Wait for all the commands running in the background.
+    void waitBackground();
+    /// \brief Take an idle worker client, or open a channel for a new one.
+    /// \return nullptr if every channel is in use.
+    unique_ptr<Client> takeWorker();
+    /// \brief Negotiate the options of this client on the channel of a new worker, nothing to do for the others.
+    /// \return false if the other node refused the options.
+    bool prepareWorker(Client& worker);
+    /// \brief Give a worker back to the idle ones, to be reused by the next commands.
+    void releaseWorker(unique_ptr<Client> worker);
+
     /// \brief Requests a 'ls' command to the server.
     /// \return true if the execution was successfull, false otherwise.
-    bool requestLS();
+    bool requestLS(istream& arguments);
     /// \brief Requests a 'mkdir' command to the server.
     /// \return true if the execution was successfull, false otherwise.
-    bool requestMkdir();
+    bool requestMkdir(istream& arguments);
     /// \brief Requests a 'cd' command to the server.
     /// \return true if the execution was successfull, false otherwise.
-    void requestCD();
+    void requestCD(istream& arguments);
     /// \brief Requests a 'put' command to the server, sending a file to the server.
     /// \return true if the execution was successfull, false otherwise.
-    void requestPUT();
+    void requestPUT(istream& arguments);
     /// \brief Requests a 'get' command to the server, getting a file from the server.
     /// \return true if the execution was successfull, false otherwise.
-    void requestGET();
+    void requestGET(istream& arguments);
+    /// \brief Requests a 'put' that only sends the differences if the server already has a copy of the file.
+    void requestDPUT(istream& arguments);
+    /// \brief Requests a 'get' that only receives the differences if the client already has a copy of the file.
+    void requestDGET(istream& arguments);
+    /// \brief Requests a 'put' of each local file matching the patterns, the last argument being the remote directory.
+    void requestMPUT(istream& arguments);
+    /// \brief Requests a 'get' of each remote file matching the patterns, the last argument being the local directory.
+    void requestMGET(istream& arguments);
+
+    /// \brief Send a file to the directory writePath of the server.
+    /// \param delta Replace the copy the server may already have, sending only the blocks it doesn't have.
+    /// \return true if the execution was successfull, false otherwise.
+    bool putFile(const string& filePath, const string& writePath, bool delta = false);
+    /// \brief Get a file (or the length bytes of it starting at start) from the server, writing it to the directory
+    /// writePath.
+    /// \param delta Replace the local copy of the file if there is one, receiving only the blocks it doesn't have.
+    /// \return true if the execution was successfull, false otherwise.
+    bool getFile(const string& filePath, const string& writePath, unsigned long start = 0,
+                 unsigned long length = numeric_limits<unsigned long>::max(), bool delta = false);
+    /// \brief Put (or get) the given files, up to m_parallelTransfers at once on a multiplexed link, so the round
+    /// trips of a file overlap with the data of the others.
+    void transferFiles(bool upload, const vector<string>& files, const string& destination);
 
     /// \brief Executes a ls on the client.
-    void requestLocalLS();
+    void requestLocalLS(istream& arguments);
     /// \brief executes a mkdir on the client.
-    void requestLocalMkdir();
+    void requestLocalMkdir(istream& arguments);
+
+    /// \brief Multiplexed link of this client, nullptr if it isn't multiplexed.
+    ChannelMux *m_channels = nullptr;
+    /// \brief Guards the workers and the background threads.
+    mutex m_backgroundMutex;
+    /// \brief Worker clients not running a command, each on a channel of its own, reused by the next commands.
+    vector<unique_ptr<Client>> m_idleWorkers;
+    vector<thread> m_background;
+    /// \brief true once the options of a worker were negotiated on its channel.
+    bool m_ready = false;
+    size_t m_parallelTransfers = DEFAULT_PARALLEL_TRANSFERS;
 };
 
 
@@ -1,15 +1,93 @@
 #include "Client.h"
+#include "../Network/SessionMux.h"
+#include "../Network/ThreadedTransport.h"
 #include <iostream>
+#include <random>
 
-int main() {
+int main(int argc, char *argv[]) {
     Logger::setLevel(LoggerLevel::INFO);
 
-    std::cout << "Starting client." << std::endl;
-    Client client;
+    string transport = DEFAULT_TRANSPORT;
+    LinkOptions options;
+    bool threaded = false;
+    bool multiplexed = false;
+    bool shared = false;
+    size_t parallelTransfers = DEFAULT_PARALLEL_TRANSFERS;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--selective-repeat") {
+            options.arqMode = ArqMode::SELECTIVE_REPEAT;
+        }
+        else if (arg == "--extended-header") {
+            options.extendedHeader = true;
+        }
+        else if (arg.compare(0, 9, "--window=") == 0) {
+            options.windowSize = stoul(arg.substr(9));
+        }
+        else if (arg == "--crc32c") {
+            options.crc = true;
+        }
+        else if (arg == "--compress") {
+            options.compression = true;
+        }
+        else if (arg == "--large-frames") {
+            // Reduced to what the transport can carry when negotiating.
+            options.maxFrameSize = EXTENDED_MAX_FRAME_SIZE;
+        }
+        else if (arg.compare(0, 13, "--frame-size=") == 0) {
+            options.maxFrameSize = stoul(arg.substr(13));
+        }
+        else if (arg == "--threaded") {
+            threaded = true;
+        }
+        else if (arg == "--channels") {
+            multiplexed = true;
+        }
+        else if (arg == "--sessions") {
+            shared = true;
+        }
+        else if (arg.compare(0, 11, "--parallel=") == 0) {
+            parallelTransfers = stoul(arg.substr(11));
+        }
+        else {
+            transport = arg;
+        }
+    }
+
+    if (shared && multiplexed) {
+        std::cerr << "--sessions and --channels can't be used together." << std::endl;
+        return 1;
+    }
 
-    if (DEVICE == "lo") {
+    std::cout << "Starting client." << std::endl;
+    unique_ptr<Transport> link = Transport::create(transport);
+    // Read by every node, so set before the muxes start their threads.
+    NetworkNode::echo_transport = link->echoesOwnFrames();
+    if (NetworkNode::echo_transport) {
         NetworkNode::message_delimiter = ~BEGIN_DELIMITER;
     }
+    if (threaded) {
+        link.reset(new ThreadedTransport(move(link)));
+    }
+
+    // A random session id, so the clients of a server don't need to agree on theirs.
+    unique_ptr<SessionMux> sessions;
+    if (shared) {
+        sessions.reset(new SessionMux(move(link)));
+        link = sessions->open(random_device()());
+    }
+
+    // Commands ending with '&' run on channels 1 to 255, the prompt uses channel 0.
+    unique_ptr<ChannelMux> channels;
+    if (multiplexed) {
+        channels.reset(new ChannelMux(move(link)));
+        link = channels->open(0);
+    }
+    Client client(move(link));
+    client.setChannels(channels.get());
+    client.setParallelTransfers(parallelTransfers);
+
+    client.negotiate(options);
 
     while (true) {
         client.waitCommand();
@@ -0,0 +1,285 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "AsyncFileIO.h"
+#include "UringFileIO.h"
+
+unique_ptr<AsyncFileIO> AsyncFileIO::create(size_t depth) {
+    try {
+        return unique_ptr<AsyncFileIO>(new UringFileIO(depth));
+    }
+    catch (runtime_error&) {
+        // Old kernels, or io_uring disabled by seccomp or sysctl.
+        return unique_ptr<AsyncFileIO>(new ThreadPoolFileIO(depth));
+    }
+}
+
+/// \brief Read or write the whole range, continuing after short transfers.
+/// \return The bytes transferred (less than size only at the end of the file), or -errno.
+static long transferFully(bool write, int fd, char *buffer, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = write ? pwrite(fd, buffer + done, size - done, offset + static_cast<off_t>(done)) :
+                                 pread(fd, buffer + done, size - done, offset + static_cast<off_t>(done));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (result == 0) {
+            break;
+        }
+        done += static_cast<size_t>(result);
+    }
+    return static_cast<long>(done);
+}
+
+ThreadPoolFileIO::ThreadPoolFileIO(size_t depth, size_t threads) : AsyncFileIO(depth) {
+    for (size_t i = 0; i < threads; i++) {
+        this->m_threads.emplace_back(&ThreadPoolFileIO::work, this);
+    }
+}
+
+ThreadPoolFileIO::~ThreadPoolFileIO() {
+    {
+        lock_guard<mutex> lock(this->m_mutex);
+        this->m_stopping = true;
+    }
+    this->m_jobReady.notify_all();
+    for (auto& thread : this->m_threads) {
+        thread.join();
+    }
+}
+
+bool ThreadPoolFileIO::submitRead(int fd, char *buffer, size_t size, off_t offset, unsigned long tag) {
+    return this->submit({false, fd, buffer, size, offset, tag});
+}
+
+bool ThreadPoolFileIO::submitWrite(int fd, const char *buffer, size_t size, off_t offset, unsigned long tag) {
+    // The buffer is only read by pwrite.
+    return this->submit({true, fd, const_cast<char *>(buffer), size, offset, tag});
+}
+
+bool ThreadPoolFileIO::submit(const Job &job) {
+    if (this->m_inFlight >= this->m_depth) {
+        return false;
+    }
+    {
+        lock_guard<mutex> lock(this->m_mutex);
+        this->m_jobs.push_back(job);
+    }
+    this->m_inFlight++;
+    this->m_jobReady.notify_one();
+    return true;
+}
+
+size_t ThreadPoolFileIO::complete(vector<FileCompletion> &completions, bool wait) {
+    unique_lock<mutex> lock(this->m_mutex);
+    if (wait && this->m_inFlight > 0) {
+        this->m_jobDone.wait(lock, [this] { return !this->m_done.empty(); });
+    }
+
+    size_t count = this->m_done.size();
+    completions.insert(completions.end(), this->m_done.begin(), this->m_done.end());
+    this->m_done.clear();
+    this->m_inFlight -= count;
+    return count;
+}
+
+void ThreadPoolFileIO::work() {
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(this->m_mutex);
+            this->m_jobReady.wait(lock, [this] { return this->m_stopping || !this->m_jobs.empty(); });
+            if (this->m_jobs.empty()) {
+                return;
+            }
+            job = this->m_jobs.front();
+            this->m_jobs.pop_front();
+        }
+
+        long result = transferFully(job.write, job.fd, job.buffer, job.size, job.offset);
+        {
+            lock_guard<mutex> lock(this->m_mutex);
+            this->m_done.push_back({job.tag, result});
+        }
+        this->m_jobDone.notify_one();
+    }
+}
+
+AsyncFileReader::AsyncFileReader(const string &filePath, size_t chunkSize, size_t depth) :
+        AsyncFileReader(filePath, chunkSize, 0, numeric_limits<off_t>::max(), depth) {}
+
+AsyncFileReader::AsyncFileReader(const string &filePath, size_t chunkSize, off_t start, off_t length, size_t depth) :
+        m_start(start), m_chunkSize(chunkSize), m_io(AsyncFileIO::create(depth)) {
+    this->m_fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (this->m_fd != -1 && fstat(this->m_fd, &status) == -1) {
+        close(this->m_fd);
+        this->m_fd = -1;
+    }
+    if (this->m_fd == -1) {
+        return;
+    }
+    this->m_end = length < status.st_size - start ? start + length : status.st_size;
+
+    this->m_slots.resize(this->m_io->depth(), vector<char>(chunkSize));
+    this->m_results.resize(this->m_io->depth());
+    this->submitReads();
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    // Let the reads in flight finish before their buffers are released.
+    vector<FileCompletion> completions;
+    while (this->m_io->inFlight() > 0) {
+        this->m_io->complete(completions, true);
+    }
+    if (this->m_fd != -1) {
+        close(this->m_fd);
+    }
+}
+
+void AsyncFileReader::submitReads() {
+    while (this->m_nextSubmit < this->m_nextRead + this->m_slots.size() &&
+           this->offsetOf(this->m_nextSubmit) < this->m_end) {
+        size_t slot = this->m_nextSubmit % this->m_slots.size();
+        this->m_results[slot] = -EINPROGRESS;
+        if (!this->m_io->submitRead(this->m_fd, this->m_slots[slot].data(), this->m_chunkSize,
+                                    this->offsetOf(this->m_nextSubmit), this->m_nextSubmit)) {
+            break;
+        }
+        this->m_nextSubmit++;
+    }
+}
+
+size_t AsyncFileReader::read(char *buffer, size_t size) {
+    off_t offset = this->offsetOf(this->m_nextRead);
+    if (!this->isOpen() || this->m_failed || offset >= this->m_end) {
+        return 0;
+    }
+
+    size_t slot = this->m_nextRead % this->m_slots.size();
+    vector<FileCompletion> completions;
+    while (this->m_results[slot] == -EINPROGRESS) {
+        completions.clear();
+        this->m_io->complete(completions, true);
+        for (const auto& completion : completions) {
+            this->m_results[completion.tag % this->m_slots.size()] = completion.result;
+        }
+    }
+
+    size_t expected = static_cast<size_t>(min(static_cast<off_t>(this->m_chunkSize), this->m_end - offset));
+    long result = this->m_results[slot];
+    if (result >= 0 && static_cast<size_t>(result) < expected) {
+        // Short read before the end of the file, finish it here.
+        long rest = transferFully(false, this->m_fd, this->m_slots[slot].data() + result,
+                                  expected - static_cast<size_t>(result), offset + result);
+        result = rest < 0 ? rest : result + rest;
+    }
+    if (result < 0) {
+        this->m_failed = true;
+        return 0;
+    }
+
+    // The last chunk of a range may have been read past its end.
+    size_t count = min(size, min(expected, static_cast<size_t>(result)));
+    memcpy(buffer, this->m_slots[slot].data(), count);
+    this->m_nextRead++;
+    this->submitReads();
+    return count;
+}
+
+AsyncFileWriter::AsyncFileWriter(const string &filePath, size_t depth) : AsyncFileWriter(filePath, 0, depth) {}
+
+AsyncFileWriter::AsyncFileWriter(const string &filePath, off_t start, size_t depth) :
+        m_offset(start), m_io(AsyncFileIO::create(depth)) {
+    this->m_fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (this->m_fd != -1 && ftruncate(this->m_fd, start) == -1) {
+        close(this->m_fd);
+        this->m_fd = -1;
+    }
+    this->m_slots.resize(this->m_io->depth());
+    for (size_t i = 0; i < this->m_slots.size(); i++) {
+        this->m_freeSlots.push_back(i);
+    }
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    this->finish();
+}
+
+bool AsyncFileWriter::write(const char *data, size_t size) {
+    if (!this->isOpen() || this->m_failed) {
+        return false;
+    }
+
+    while (this->m_freeSlots.empty()) {
+        this->reap(true);
+    }
+    size_t index = this->m_freeSlots.back();
+    this->m_freeSlots.pop_back();
+
+    Slot& slot = this->m_slots[index];
+    slot.buffer.assign(data, data + size);
+    slot.size = size;
+    slot.offset = this->m_offset;
+    this->m_offset += static_cast<off_t>(size);
+    this->m_io->submitWrite(this->m_fd, slot.buffer.data(), size, slot.offset, index);
+    // Hands the write to the kernel (or just collects finished ones) without waiting.
+    this->reap(false);
+    return !this->m_failed;
+}
+
+void AsyncFileWriter::reap(bool wait) {
+    vector<FileCompletion> completions;
+    this->m_io->complete(completions, wait);
+    for (const auto& completion : completions) {
+        Slot& slot = this->m_slots[completion.tag];
+        long result = completion.result;
+        if (result >= 0 && static_cast<size_t>(result) < slot.size) {
+            long rest = transferFully(true, this->m_fd, slot.buffer.data() + result,
+                                      slot.size - static_cast<size_t>(result), slot.offset + result);
+            result = rest < 0 ? rest : result + rest;
+        }
+        if (result < 0 || static_cast<size_t>(result) != slot.size) {
+            this->m_failed = true;
+        }
+        this->m_freeSlots.push_back(completion.tag);
+    }
+}
+
+bool AsyncFileWriter::flush() {
+    if (!this->isOpen()) {
+        return false;
+    }
+
+    while (this->m_io->inFlight() > 0) {
+        this->reap(true);
+    }
+    if (fdatasync(this->m_fd) == -1) {
+        this->m_failed = true;
+    }
+    return !this->m_failed;
+}
+
+bool AsyncFileWriter::finish() {
+    if (!this->isOpen()) {
+        return false;
+    }
+
+    while (this->m_io->inFlight() > 0) {
+        this->reap(true);
+    }
+    if (close(this->m_fd) == -1) {
+        this->m_failed = true;
+    }
+    this->m_fd = -1;
+    return !this->m_failed;
+}
@@ -0,0 +1,172 @@
+#ifndef REDES_1_T1_ASYNCFILEIO_H
+#define REDES_1_T1_ASYNCFILEIO_H
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// \brief Default number of reads or writes kept in flight by a file stream.
+#define ASYNC_IO_DEPTH 8u
+/// \brief Threads of the fallback engine, used when io_uring isn't available.
+#define ASYNC_IO_THREADS 2u
+
+/// \brief Result of a finished read or write.
+struct FileCompletion {
+    /// \brief Value given when the operation was submitted.
+    unsigned long tag;
+    /// \brief Bytes read or written, or -errno.
+    long result;
+};
+
+/**
+ * @brief Engine that reads and writes file chunks in the background. Operations are submitted with a tag and their
+ * results are collected later with complete, in any order.
+ *
+ * The buffer of an operation must stay valid until its completion is collected.
+ */
+class AsyncFileIO {
+public:
+    virtual ~AsyncFileIO() = default;
+
+    /// \brief Queue a read of size bytes of fd at offset into buffer.
+    /// \return false if depth operations are already in flight.
+    virtual bool submitRead(int fd, char *buffer, size_t size, off_t offset, unsigned long tag) = 0;
+    /// \brief Queue a write of size bytes of buffer to fd at offset.
+    /// \return false if depth operations are already in flight.
+    virtual bool submitWrite(int fd, const char *buffer, size_t size, off_t offset, unsigned long tag) = 0;
+    /// \brief Append the finished operations to completions.
+    /// \param wait block until at least one operation finishes, if any is in flight.
+    /// \return The number of completions appended.
+    virtual size_t complete(vector<FileCompletion>& completions, bool wait) = 0;
+
+    size_t inFlight() const { return m_inFlight; }
+    size_t depth() const { return m_depth; }
+
+    /// \brief Create an io_uring engine, or a thread pool engine if the kernel doesn't allow it.
+    static unique_ptr<AsyncFileIO> create(size_t depth = ASYNC_IO_DEPTH);
+
+protected:
+    explicit AsyncFileIO(size_t depth) : m_depth(depth) {}
+
+    size_t m_depth;
+    size_t m_inFlight = 0;
+};
+
+/// \brief Engine that runs blocking pread/pwrite calls in a few worker threads.
+class ThreadPoolFileIO: public AsyncFileIO {
+public:
+    explicit ThreadPoolFileIO(size_t depth, size_t threads = ASYNC_IO_THREADS);
+    ~ThreadPoolFileIO() override;
+
+    bool submitRead(int fd, char *buffer, size_t size, off_t offset, unsigned long tag) override;
+    bool submitWrite(int fd, const char *buffer, size_t size, off_t offset, unsigned long tag) override;
+    size_t complete(vector<FileCompletion>& completions, bool wait) override;
+
+private:
+    struct Job {
+        bool write;
+        int fd;
+        char *buffer;
+        size_t size;
+        off_t offset;
+        unsigned long tag;
+    };
+
+    mutex m_mutex;
+    condition_variable m_jobReady;
+    condition_variable m_jobDone;
+    deque<Job> m_jobs;
+    vector<FileCompletion> m_done;
+    vector<thread> m_threads;
+    bool m_stopping = false;
+
+    bool submit(const Job& job);
+    void work();
+};
+
+/**
+ * @brief Reads a file (or a range of it) from the start to the end in chunks, keeping the next chunks in flight while
+ * the current one is consumed.
+ */
+class AsyncFileReader {
+public:
+    AsyncFileReader(const string& filePath, size_t chunkSize, size_t depth = ASYNC_IO_DEPTH);
+    /// \brief Read only the length bytes starting at start, or until the end of the file if it is shorter.
+    AsyncFileReader(const string& filePath, size_t chunkSize, off_t start, off_t length,
+                    size_t depth = ASYNC_IO_DEPTH);
+    ~AsyncFileReader();
+
+    bool isOpen() const { return m_fd != -1; }
+    /// \brief Copy the next chunk of the file to buffer, waiting for it if its read didn't finish yet.
+    /// \return The number of bytes copied, 0 at the end of the file or after an error.
+    size_t read(char *buffer, size_t size);
+    bool failed() const { return m_failed; }
+
+private:
+    int m_fd = -1;
+    off_t m_start = 0;
+    /// \brief Where the reads stop, the end of the file or of the range.
+    off_t m_end = 0;
+    size_t m_chunkSize;
+    unique_ptr<AsyncFileIO> m_io;
+    /// \brief One buffer per chunk in flight, the chunk n uses the slot n % depth.
+    vector<vector<char>> m_slots;
+    vector<long> m_results;
+    unsigned long m_nextSubmit = 0;
+    unsigned long m_nextRead = 0;
+    bool m_failed = false;
+
+    void submitReads();
+    /// \brief Offset in the file of the chunk n.
+    off_t offsetOf(unsigned long chunk) const { return m_start + static_cast<off_t>(chunk * m_chunkSize); }
+};
+
+/**
+ * @brief Writes a file from the start to the end in chunks without waiting for the disk, unless depth writes are
+ * already in flight.
+ */
+class AsyncFileWriter {
+public:
+    explicit AsyncFileWriter(const string& filePath, size_t depth = ASYNC_IO_DEPTH);
+    /// \brief Keep the first start bytes of an existing file, discarding the rest, and append after them.
+    AsyncFileWriter(const string& filePath, off_t start, size_t depth = ASYNC_IO_DEPTH);
+    ~AsyncFileWriter();
+
+    bool isOpen() const { return m_fd != -1; }
+    /// \brief Append size bytes of data to the file. The data is copied, so it may be reused right away.
+    /// \return false if this or a previous write failed.
+    bool write(const char *data, size_t size);
+    /// \brief Wait for every write in flight and for the data to reach the disk.
+    /// \return false if any write failed.
+    bool flush();
+    /// \brief Wait for every write in flight and close the file.
+    /// \return false if any write failed.
+    bool finish();
+
+private:
+    struct Slot {
+        vector<char> buffer;
+        size_t size = 0;
+        off_t offset = 0;
+    };
+
+    int m_fd = -1;
+    off_t m_offset = 0;
+    unique_ptr<AsyncFileIO> m_io;
+    vector<Slot> m_slots;
+    vector<size_t> m_freeSlots;
+    bool m_failed = false;
+
+    /// \brief Release the slots of the finished writes.
+    void reap(bool wait);
+};
+
+
+#endif //REDES_1_T1_ASYNCFILEIO_H
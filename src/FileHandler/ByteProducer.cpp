@@ -0,0 +1,22 @@
+#include <algorithm>
+#include <cstring>
+#include "ByteProducer.h"
+
+size_t ByteProducer::read(char *buffer, size_t size) {
+    size_t copied = 0;
+    while (copied < size) {
+        if (this->m_outputStart < this->m_output.size()) {
+            size_t count = min(size - copied, this->m_output.size() - this->m_outputStart);
+            memcpy(buffer + copied, this->m_output.data() + this->m_outputStart, count);
+            this->m_outputStart += count;
+            copied += count;
+            continue;
+        }
+        this->m_output.clear();
+        this->m_outputStart = 0;
+        if (!this->produce()) {
+            break;
+        }
+    }
+    return copied;
+}
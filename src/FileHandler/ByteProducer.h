@@ -0,0 +1,30 @@
+#ifndef REDES_1_T1_BYTEPRODUCER_H
+#define REDES_1_T1_BYTEPRODUCER_H
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Bytes produced on demand and handed out in chunks of any size, the way NetworkNode streams a sequence.
+ */
+class ByteProducer {
+public:
+    virtual ~ByteProducer() = default;
+    /// \brief Fill buffer with the next bytes, only less than size at the end.
+    /// \return The number of bytes written, 0 once everything was read.
+    size_t read(char *buffer, size_t size);
+
+protected:
+    vector<char> m_output;
+    /// \brief Append more bytes to m_output.
+    /// \return false once there is nothing else to produce.
+    virtual bool produce() = 0;
+
+private:
+    size_t m_outputStart = 0;
+};
+
+
+#endif //REDES_1_T1_BYTEPRODUCER_H
@@ -0,0 +1,278 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include "ChunkStore.h"
+
+/// \brief Bits of the gear hash that must be zero to cut a chunk before and after the average size. More bits before
+/// it make small chunks less likely, fewer after it make large ones less likely, so most chunks are close to it.
+#define CHUNK_MASK_SMALL 0xFFFF000000000000ull
+#define CHUNK_MASK_LARGE 0xFFF0000000000000ull
+/// \brief Data read from the file at once by splitFile.
+#define CHUNK_READ_SIZE static_cast<size_t>(4 * 1024 * 1024)
+
+namespace {
+    /// \brief Random value of each byte for the gear hash, the same in every node since it decides where files are cut.
+    const uint64_t *gearTable() {
+        static const array<uint64_t, 256> table = [] {
+            array<uint64_t, 256> values{};
+            // splitmix64, with a fixed seed.
+            uint64_t state = 0x52656465735f3154ull;
+            for (uint64_t &value : values) {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                value = z ^ (z >> 31);
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    /// \brief Size of the chunk at the start of size bytes of data, size being at most CHUNK_MAX_SIZE unless the file
+    /// goes on.
+    size_t cutPoint(const unsigned char *data, size_t size) {
+        if (size <= CHUNK_MIN_SIZE) {
+            return size;
+        }
+        const uint64_t *gear = gearTable();
+        size_t average = min(CHUNK_AVERAGE_SIZE, size);
+        size_t maximum = min(CHUNK_MAX_SIZE, size);
+        uint64_t hash = 0;
+        size_t i = CHUNK_MIN_SIZE;
+        for (; i < average; ++i) {
+            hash = (hash << 1) + gear[data[i]];
+            if ((hash & CHUNK_MASK_SMALL) == 0) {
+                return i + 1;
+            }
+        }
+        for (; i < maximum; ++i) {
+            hash = (hash << 1) + gear[data[i]];
+            if ((hash & CHUNK_MASK_LARGE) == 0) {
+                return i + 1;
+            }
+        }
+        return maximum;
+    }
+
+    void putUint32(vector<unsigned char>& output, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            output.push_back(static_cast<unsigned char>((value >> shift) & 0xFF));
+        }
+    }
+
+    uint32_t getUint32(const unsigned char *data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+
+    /// \brief Read or write all of size bytes, retrying short transfers.
+    bool transferAll(bool write, int fd, char *data, size_t size) {
+        while (size > 0) {
+            ssize_t count = write ? ::write(fd, data, size) : ::read(fd, data, size);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            data += count;
+            size -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+}
+
+void chunkHash(const void *data, size_t size, unsigned char *hash) {
+    EVP_Digest(data, size, hash, nullptr, EVP_sha256(), nullptr);
+}
+
+bool splitFile(const string &filePath, vector<FileChunk> &chunks) {
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    vector<unsigned char> buffer(CHUNK_READ_SIZE + CHUNK_MAX_SIZE);
+    size_t start = 0, end = 0;
+    off_t offset = 0;
+    bool fileDone = false;
+    bool failed = false;
+    while (true) {
+        // A whole chunk of the largest size is in the buffer before cutting, unless the file ends first.
+        if (end - start < CHUNK_MAX_SIZE && !fileDone) {
+            memmove(buffer.data(), buffer.data() + start, end - start);
+            end -= start;
+            start = 0;
+            ssize_t count = read(fd, buffer.data() + end, buffer.size() - end);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            failed = count < 0;
+            fileDone = count <= 0;
+            end += static_cast<size_t>(max(count, static_cast<ssize_t>(0)));
+            continue;
+        }
+        if (start == end) {
+            break;
+        }
+
+        FileChunk chunk;
+        chunk.size = static_cast<uint32_t>(cutPoint(buffer.data() + start, end - start));
+        chunk.offset = offset;
+        chunkHash(buffer.data() + start, chunk.size, chunk.hash);
+        chunks.push_back(chunk);
+        start += chunk.size;
+        offset += chunk.size;
+    }
+    close(fd);
+    return !failed;
+}
+
+vector<unsigned char> encodeChunks(const vector<FileChunk> &chunks) {
+    vector<unsigned char> list;
+    list.reserve(chunks.size() * CHUNK_ENTRY_SIZE);
+    for (const FileChunk& chunk : chunks) {
+        list.insert(list.end(), chunk.hash, chunk.hash + CHUNK_HASH_SIZE);
+        putUint32(list, chunk.size);
+    }
+    return list;
+}
+
+bool decodeChunks(const vector<unsigned char> &list, vector<FileChunk> &chunks) {
+    if (list.size() % CHUNK_ENTRY_SIZE != 0) {
+        return false;
+    }
+    off_t offset = 0;
+    for (size_t i = 0; i < list.size(); i += CHUNK_ENTRY_SIZE) {
+        FileChunk chunk;
+        memcpy(chunk.hash, list.data() + i, CHUNK_HASH_SIZE);
+        chunk.size = getUint32(list.data() + i + CHUNK_HASH_SIZE);
+        chunk.offset = offset;
+        if (chunk.size == 0 || chunk.size > CHUNK_MAX_SIZE) {
+            return false;
+        }
+        offset += chunk.size;
+        chunks.push_back(chunk);
+    }
+    return true;
+}
+
+FileChunkReader::FileChunkReader(const string &filePath, vector<FileChunk> chunks) : m_chunks(move(chunks)) {
+    this->m_fd = open(filePath.c_str(), O_RDONLY);
+}
+
+FileChunkReader::~FileChunkReader() {
+    if (this->m_fd != -1) {
+        close(this->m_fd);
+    }
+}
+
+size_t FileChunkReader::read(char *buffer, size_t size) {
+    size_t copied = 0;
+    while (copied < size && this->isOpen() && this->m_next < this->m_chunks.size()) {
+        const FileChunk& chunk = this->m_chunks[this->m_next];
+        size_t count = min(size - copied, chunk.size - this->m_chunkRead);
+        ssize_t result = pread(this->m_fd, buffer + copied, count,
+                               chunk.offset + static_cast<off_t>(this->m_chunkRead));
+        if (result <= 0) {
+            // The other node finds the chunks it is missing and rejects the file.
+            close(this->m_fd);
+            this->m_fd = -1;
+            break;
+        }
+        copied += static_cast<size_t>(result);
+        this->m_chunkRead += static_cast<size_t>(result);
+        if (this->m_chunkRead == chunk.size) {
+            this->m_chunkRead = 0;
+            ++this->m_next;
+        }
+    }
+    return copied;
+}
+
+ChunkStore::ChunkStore(const string &directory) : m_directory(directory) {
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        throw runtime_error("Could not create the chunk store " + directory + ": " + strerror(errno));
+    }
+}
+
+string ChunkStore::pathOf(const unsigned char *hash) const {
+    static const char digits[] = "0123456789abcdef";
+    string name;
+    for (size_t i = 0; i < CHUNK_HASH_SIZE; ++i) {
+        name += digits[hash[i] >> 4];
+        name += digits[hash[i] & 0xF];
+    }
+    return this->m_directory + "/" + name.substr(0, 2) + "/" + name.substr(2);
+}
+
+bool ChunkStore::put(const unsigned char *hash, const char *data, size_t size) const {
+    string path = this->pathOf(hash);
+    if (access(path.c_str(), F_OK) == 0) {
+        return true;
+    }
+    string directory = path.substr(0, path.rfind('/'));
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+
+    // Other nodes may store the same chunk at the same time, each one writes a temporary file of its own.
+    string temporaryPath = directory + "/.tmpXXXXXX";
+    int fd = mkstemp(&temporaryPath[0]);
+    if (fd == -1) {
+        return false;
+    }
+    bool written = transferAll(true, fd, const_cast<char *>(data), size);
+    written = close(fd) == 0 && written;
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ChunkStore::sync() const {
+    // A single syncfs instead of a fsync of each chunk and of its directory, thousands for a large file.
+    int fd = open(this->m_directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return false;
+    }
+    bool synced = syncfs(fd) == 0;
+    return close(fd) == 0 && synced;
+}
+
+bool ChunkStore::get(const unsigned char *hash, size_t size, vector<char> &data) const {
+    string path = this->pathOf(hash);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    // Only the content of a chunk tells if it is damaged. The expected size comes from the other node, a wrong one
+    // must not remove a chunk other files (and other sessions) use.
+    struct stat status;
+    bool result = fstat(fd, &status) == 0;
+    bool damaged = result && status.st_size > static_cast<off_t>(CHUNK_MAX_SIZE);
+    result = result && !damaged;
+    if (result) {
+        data.resize(static_cast<size_t>(status.st_size));
+        result = transferAll(false, fd, data.data(), data.size());
+    }
+    close(fd);
+
+    if (result) {
+        unsigned char storedHash[CHUNK_HASH_SIZE];
+        chunkHash(data.data(), data.size(), storedHash);
+        damaged = memcmp(storedHash, hash, CHUNK_HASH_SIZE) != 0;
+        result = !damaged && data.size() == size;
+    }
+    if (damaged) {
+        // Received again instead.
+        remove(path.c_str());
+    }
+    return result;
+}
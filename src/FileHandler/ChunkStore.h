@@ -0,0 +1,96 @@
+#ifndef REDES_1_T1_CHUNKSTORE_H
+#define REDES_1_T1_CHUNKSTORE_H
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Bounds and average size of the chunks a file is cut in. The cuts depend only on the data around them, so an
+/// insertion only changes the chunks next to it, and equal regions of different files give the same chunks.
+#define CHUNK_MIN_SIZE static_cast<size_t>(4 * 1024)
+#define CHUNK_AVERAGE_SIZE static_cast<size_t>(16 * 1024)
+#define CHUNK_MAX_SIZE static_cast<size_t>(64 * 1024)
+/// \brief SHA-256 of a chunk, which names it in the store.
+#define CHUNK_HASH_SIZE static_cast<size_t>(32)
+/// \brief Hash and 32 bit size of a chunk in a list of chunks.
+#define CHUNK_ENTRY_SIZE (CHUNK_HASH_SIZE + 4)
+
+/// \brief A piece of a file, cut by splitFile.
+struct FileChunk {
+    unsigned char hash[CHUNK_HASH_SIZE];
+    uint32_t size;
+    /// \brief Where the chunk starts in the file, not part of the list sent to the other node.
+    off_t offset;
+};
+
+/// \brief Cut a file in content defined chunks (FastCDC, with a gear rolling hash), hashing each of them.
+/// \return false if the file couldn't be read.
+bool splitFile(const string& filePath, vector<FileChunk>& chunks);
+/// \brief The list of chunks sent to the other node, the hash and size of each of them.
+vector<unsigned char> encodeChunks(const vector<FileChunk>& chunks);
+/// \brief Read a list made by encodeChunks, the offsets being those of a file made of the chunks in order.
+/// \return false if the list is malformed.
+bool decodeChunks(const vector<unsigned char>& list, vector<FileChunk>& chunks);
+/// \brief SHA-256 of size bytes of data.
+void chunkHash(const void *data, size_t size, unsigned char *hash);
+
+/**
+ * @brief Reads the given chunks of a file one after the other, as a single stream.
+ */
+class FileChunkReader {
+public:
+    FileChunkReader(const string& filePath, vector<FileChunk> chunks);
+    ~FileChunkReader();
+    FileChunkReader(const FileChunkReader&) = delete;
+    FileChunkReader& operator=(const FileChunkReader&) = delete;
+
+    bool isOpen() const { return m_fd != -1; }
+    /// \brief Fill buffer with the next bytes of the chunks, only less than size after the last one.
+    /// \return The number of bytes read, 0 once every chunk was read or after an error.
+    size_t read(char *buffer, size_t size);
+
+private:
+    int m_fd = -1;
+    vector<FileChunk> m_chunks;
+    size_t m_next = 0;
+    size_t m_chunkRead = 0;
+};
+
+/**
+ * @brief Chunks of the files received by the server, stored once each in a directory and named by their hash, so the
+ * chunks a new file shares with any file received before don't need to be sent again.
+ *
+ * The store is only a directory, it may be shared by several nodes and survives restarts: chunks are written to a
+ * temporary file and renamed, so a chunk that exists was written whole, and reach the disk with sync once a file was
+ * received. A chunk damaged anyway (e.g. by a crash before the sync, or by the disk) is found by get and removed, so it
+ * is received again.
+ */
+class ChunkStore {
+public:
+    /// \brief Use (and create if needed) the given directory.
+    /// \throw runtime_error if it can't be created.
+    explicit ChunkStore(const string& directory);
+
+    /// \brief Store a chunk, unless it is already stored. It only reaches the disk after a sync.
+    /// \return false if it couldn't be written.
+    bool put(const unsigned char *hash, const char *data, size_t size) const;
+    /// \brief Make the chunks stored so far reach the disk, with their directories.
+    /// \return false if they couldn't be written.
+    bool sync() const;
+    /// \brief Read a whole chunk of size bytes into data, checking its hash. A chunk whose content doesn't match its hash
+    /// is removed, as if it was never stored.
+    /// \return false if it isn't stored (or no longer), couldn't be read or doesn't have size bytes.
+    bool get(const unsigned char *hash, size_t size, vector<char>& data) const;
+
+private:
+    string m_directory;
+
+    /// \brief Chunks are spread in 256 subdirectories by the first byte of their hash, to keep each one small.
+    string pathOf(const unsigned char *hash) const;
+};
+
+
+#endif //REDES_1_T1_CHUNKSTORE_H
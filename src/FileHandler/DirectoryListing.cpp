@@ -0,0 +1,327 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include "DirectoryListing.h"
+
+namespace {
+    /// \brief Record returned by getdents64, which glibc doesn't declare.
+    struct LinuxDirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    void putInteger(vector<char>& output, uint64_t value, int bytes) {
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+            output.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    uint64_t getInteger(const unsigned char *data, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | data[i];
+        }
+        return value;
+    }
+
+    void putString(vector<char>& output, const string& text, int sizeBytes) {
+        size_t size = min(text.size(), static_cast<size_t>((1ul << (8 * sizeBytes)) - 1));
+        putInteger(output, size, sizeBytes);
+        output.insert(output.end(), text.begin(), text.begin() + static_cast<long>(size));
+    }
+
+    char typeOfDirent(unsigned char type) {
+        switch (type) {
+            case DT_REG:
+                return '-';
+            case DT_DIR:
+                return 'd';
+            case DT_LNK:
+                return 'l';
+            case DT_CHR:
+                return 'c';
+            case DT_BLK:
+                return 'b';
+            case DT_FIFO:
+                return 'p';
+            case DT_SOCK:
+                return 's';
+            default:
+                return '?';
+        }
+    }
+
+    char typeOfMode(mode_t mode) {
+        switch (mode & S_IFMT) {
+            case S_IFREG:
+                return '-';
+            case S_IFDIR:
+                return 'd';
+            case S_IFLNK:
+                return 'l';
+            case S_IFCHR:
+                return 'c';
+            case S_IFBLK:
+                return 'b';
+            case S_IFIFO:
+                return 'p';
+            case S_IFSOCK:
+                return 's';
+            default:
+                return '?';
+        }
+    }
+}
+
+bool parseListOptions(const string &options, unsigned &flags) {
+    for (size_t i = 1; i < options.size(); ++i) {
+        switch (options[i]) {
+            case 'l':
+                flags |= LIST_LONG;
+                break;
+            case 'a':
+                flags |= LIST_ALL;
+                break;
+            case 'A':
+                flags |= LIST_ALMOST_ALL;
+                break;
+            case '1':
+                // Always one entry per line.
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+DirectoryLister::DirectoryLister(const string &path, unsigned flags) :
+        m_flags(flags), m_entries(DIRECTORY_READ_SIZE) {
+    this->m_directory = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (this->m_directory != -1) {
+        return;
+    }
+
+    // Like ls, a file is listed by itself.
+    struct stat status;
+    if (errno == ENOTDIR && lstat(path.c_str(), &status) == 0) {
+        this->m_fileName = path;
+    }
+    else {
+        this->m_error = "ls: cannot access '" + path + "': " + strerror(errno);
+    }
+}
+
+DirectoryLister::~DirectoryLister() {
+    if (this->m_directory != -1) {
+        close(this->m_directory);
+    }
+}
+
+bool DirectoryLister::produce() {
+    if (!this->m_headerDone) {
+        this->m_headerDone = true;
+        this->m_output.push_back(static_cast<char>(this->m_flags));
+        return true;
+    }
+    if (this->m_finished || !this->isOpen()) {
+        return false;
+    }
+    if (!this->m_fileName.empty()) {
+        this->encode(AT_FDCWD, this->m_fileName.c_str(), DT_UNKNOWN);
+        this->m_finished = true;
+        return true;
+    }
+
+    for (int encoded = 0; encoded < LIST_BATCH_SIZE;) {
+        if (this->m_entriesStart == this->m_entriesEnd) {
+            long read = syscall(SYS_getdents64, this->m_directory, this->m_entries.data(), this->m_entries.size());
+            if (read <= 0) {
+                this->m_finished = true;
+                break;
+            }
+            this->m_entriesStart = 0;
+            this->m_entriesEnd = static_cast<size_t>(read);
+        }
+
+        auto entry = reinterpret_cast<const LinuxDirent64 *>(this->m_entries.data() + this->m_entriesStart);
+        this->m_entriesStart += entry->d_reclen;
+        const char *name = entry->d_name;
+        if (name[0] == '.' && !(this->m_flags & LIST_ALL)) {
+            bool special = strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+            if (special || !(this->m_flags & LIST_ALMOST_ALL)) {
+                continue;
+            }
+        }
+        this->encode(this->m_directory, name, entry->d_type);
+        ++encoded;
+    }
+    return !this->m_output.empty();
+}
+
+void DirectoryLister::encode(int directory, const char *name, unsigned char type) {
+    if (!(this->m_flags & LIST_LONG)) {
+        // The type comes with the entry, so a short listing doesn't look at the files themselves.
+        this->m_output.push_back(typeOfDirent(type));
+        putString(this->m_output, name, 2);
+        return;
+    }
+
+    struct stat status;
+    if (fstatat(directory, name, &status, AT_SYMLINK_NOFOLLOW) == -1) {
+        // The file was removed after it was read from the directory.
+        memset(&status, 0, sizeof(status));
+        status.st_mode = DTTOIF(type);
+    }
+    this->m_output.push_back(typeOfMode(status.st_mode));
+    putString(this->m_output, name, 2);
+    putInteger(this->m_output, status.st_mode, 4);
+    putInteger(this->m_output, status.st_nlink, 4);
+    putInteger(this->m_output, static_cast<uint64_t>(status.st_size), 8);
+    putInteger(this->m_output, static_cast<uint64_t>(status.st_mtime), 8);
+    putString(this->m_output, this->ownerName(status.st_uid), 1);
+    putString(this->m_output, this->groupName(status.st_gid), 1);
+
+    string target;
+    if (S_ISLNK(status.st_mode)) {
+        char buffer[4096];
+        ssize_t size = readlinkat(directory, name, buffer, sizeof(buffer));
+        if (size > 0) {
+            target.assign(buffer, static_cast<size_t>(size));
+        }
+    }
+    putString(this->m_output, target, 2);
+}
+
+const string &DirectoryLister::ownerName(uid_t uid) {
+    auto found = this->m_owners.find(uid);
+    if (found != this->m_owners.end()) {
+        return found->second;
+    }
+    struct passwd entry, *result = nullptr;
+    char buffer[4096];
+    string name = getpwuid_r(uid, &entry, buffer, sizeof(buffer), &result) == 0 && result != nullptr
+                  ? string(result->pw_name) : to_string(uid);
+    return this->m_owners[uid] = name;
+}
+
+const string &DirectoryLister::groupName(gid_t gid) {
+    auto found = this->m_groups.find(gid);
+    if (found != this->m_groups.end()) {
+        return found->second;
+    }
+    struct group entry, *result = nullptr;
+    char buffer[4096];
+    string name = getgrgid_r(gid, &entry, buffer, sizeof(buffer), &result) == 0 && result != nullptr
+                  ? string(result->gr_name) : to_string(gid);
+    return this->m_groups[gid] = name;
+}
+
+size_t DirectoryListingParser::decode(const unsigned char *data, size_t size, DirectoryEntry &entry) const {
+    size_t position = 0;
+    bool complete = true;
+    auto integer = [&](int bytes) -> uint64_t {
+        if (!complete || size - position < static_cast<size_t>(bytes)) {
+            complete = false;
+            return 0;
+        }
+        uint64_t value = getInteger(data + position, bytes);
+        position += static_cast<size_t>(bytes);
+        return value;
+    };
+    auto text = [&](int sizeBytes, string& value) {
+        auto length = static_cast<size_t>(integer(sizeBytes));
+        if (!complete || size - position < length) {
+            complete = false;
+            return;
+        }
+        value.assign(reinterpret_cast<const char *>(data + position), length);
+        position += length;
+    };
+
+    entry.type = static_cast<char>(integer(1));
+    text(2, entry.name);
+    if (this->m_flags & LIST_LONG) {
+        entry.mode = static_cast<uint32_t>(integer(4));
+        entry.links = static_cast<uint32_t>(integer(4));
+        entry.size = integer(8);
+        entry.modified = static_cast<int64_t>(integer(8));
+        text(1, entry.owner);
+        text(1, entry.group);
+        text(2, entry.target);
+    }
+    return complete ? position : 0;
+}
+
+bool DirectoryListingParser::write(const unsigned char *data, size_t size) {
+    if (!this->m_headerDone && size > 0) {
+        this->m_flags = data[0];
+        this->m_headerDone = true;
+        ++data;
+        --size;
+    }
+    this->m_pending.insert(this->m_pending.end(), data, data + size);
+
+    size_t position = 0;
+    DirectoryEntry entry;
+    size_t entrySize;
+    while ((entrySize = this->decode(this->m_pending.data() + position, this->m_pending.size() - position, entry)) > 0) {
+        this->m_handler(entry, this->m_flags);
+        position += entrySize;
+    }
+    this->m_pending.erase(this->m_pending.begin(), this->m_pending.begin() + static_cast<long>(position));
+    // No entry is larger than a name and a link target.
+    return this->m_pending.size() < 3 * 65536;
+}
+
+string formatEntry(const DirectoryEntry &entry, bool longFormat) {
+    if (!longFormat) {
+        return entry.name;
+    }
+
+    string mode(10, '-');
+    mode[0] = entry.type;
+    const char *permissions = "rwxrwxrwx";
+    for (int i = 0; i < 9; ++i) {
+        if (entry.mode & (1u << (8 - i))) {
+            mode[i + 1] = permissions[i];
+        }
+    }
+    if (entry.mode & S_ISUID) {
+        mode[3] = mode[3] == 'x' ? 's' : 'S';
+    }
+    if (entry.mode & S_ISGID) {
+        mode[6] = mode[6] == 'x' ? 's' : 'S';
+    }
+    if (entry.mode & S_ISVTX) {
+        mode[9] = mode[9] == 'x' ? 't' : 'T';
+    }
+
+    // Like ls, the year replaces the time of the files not modified in the last six months.
+    auto modified = static_cast<time_t>(entry.modified);
+    struct tm local;
+    localtime_r(&modified, &local);
+    char date[32];
+    bool recent = labs(time(nullptr) - modified) < 6 * 30 * 24 * 3600l;
+    strftime(date, sizeof(date), recent ? "%b %e %H:%M" : "%b %e  %Y", &local);
+
+    // The columns can't be aligned to the widest value, since the entries are shown as they arrive.
+    char details[160];
+    snprintf(details, sizeof(details), "%s %3u %-8s %-8s %10llu %s ", mode.c_str(), entry.links, entry.owner.c_str(),
+             entry.group.c_str(), static_cast<unsigned long long>(entry.size), date);
+    string line = details + entry.name;
+    if (!entry.target.empty()) {
+        line += " -> " + entry.target;
+    }
+    return line;
+}
@@ -0,0 +1,115 @@
+#ifndef REDES_1_T1_DIRECTORYLISTING_H
+#define REDES_1_T1_DIRECTORYLISTING_H
+
+#include <sys/types.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ByteProducer.h"
+
+using namespace std;
+
+/// \brief Options of a listing, as the ones of ls: -l, -a and -A.
+#define LIST_LONG 1u
+#define LIST_ALL 2u
+#define LIST_ALMOST_ALL 4u
+/// \brief Buffer given to getdents64, a few hundred entries at once.
+#define DIRECTORY_READ_SIZE static_cast<size_t>(64 * 1024)
+/// \brief Entries encoded at once, so the first frames leave before the rest of the directory is read.
+#define LIST_BATCH_SIZE 64
+
+/// \brief A file of a listing. Only the type and the name are set unless the listing is long.
+struct DirectoryEntry {
+    /// \brief The first character of the mode shown by ls: '-', 'd', 'l', 'c', 'b', 'p', 's', or '?' if unknown.
+    char type = '?';
+    string name;
+    uint32_t mode = 0;
+    uint32_t links = 0;
+    uint64_t size = 0;
+    int64_t modified = 0;
+    string owner;
+    string group;
+    /// \brief Where a symbolic link points to.
+    string target;
+};
+
+/// \brief Parse the options of ls (e.g. "-la") into LIST_* flags.
+/// \return false if an option isn't supported.
+bool parseListOptions(const string& options, unsigned& flags);
+
+/**
+ * @brief Lists a directory with getdents64 (or a single file), encoding the entries as they are read instead of
+ * waiting for the whole directory, in the order of the directory (as ls -U).
+ *
+ * The listing starts with the flags (a byte), followed by each entry: its type (a byte), the 16 bit size of its name
+ * and the name. A long listing adds the mode and the number of links (32 bits each), the size and the modification
+ * time (64 bits each), the owner and the group (an 8 bit size and the name each) and the target of a link (a 16 bit
+ * size and the path).
+ */
+class DirectoryLister: public ByteProducer {
+public:
+    DirectoryLister(const string& path, unsigned flags);
+    ~DirectoryLister() override;
+    DirectoryLister(const DirectoryLister&) = delete;
+    DirectoryLister& operator=(const DirectoryLister&) = delete;
+
+    /// \brief false if the path can't be listed, error() telling why.
+    bool isOpen() const { return m_error.empty(); }
+    const string& error() const { return m_error; }
+
+protected:
+    bool produce() override;
+
+private:
+    unsigned m_flags;
+    int m_directory = -1;
+    /// \brief Set if the path is a file, listed by itself.
+    string m_fileName;
+    string m_error;
+    bool m_headerDone = false;
+    bool m_finished = false;
+    vector<char> m_entries;
+    size_t m_entriesStart = 0;
+    size_t m_entriesEnd = 0;
+    /// \brief Names of the owners and groups already looked up.
+    unordered_map<uid_t, string> m_owners;
+    unordered_map<gid_t, string> m_groups;
+
+    /// \brief Encode the entry of the given name in the directory (or of a path, with AT_FDCWD).
+    void encode(int directory, const char *name, unsigned char type);
+    const string& ownerName(uid_t uid);
+    const string& groupName(gid_t gid);
+};
+
+/**
+ * @brief Decodes a listing made by a DirectoryLister as its chunks arrive.
+ */
+class DirectoryListingParser {
+public:
+    /// \brief Called with each entry and the flags of the listing.
+    typedef function<void(const DirectoryEntry& entry, unsigned flags)> EntryHandler;
+
+    explicit DirectoryListingParser(EntryHandler handler) : m_handler(move(handler)) {}
+
+    /// \brief Decode the next chunk of the listing, calling the handler with each complete entry.
+    /// \return false if the listing is malformed.
+    bool write(const unsigned char *data, size_t size);
+
+private:
+    EntryHandler m_handler;
+    vector<unsigned char> m_pending;
+    bool m_headerDone = false;
+    unsigned m_flags = 0;
+
+    /// \brief Decode the entry at the start of data.
+    /// \return Its size, or 0 if it isn't complete yet.
+    size_t decode(const unsigned char *data, size_t size, DirectoryEntry& entry) const;
+};
+
+/// \brief Render an entry the way ls does, with its details for a long listing.
+string formatEntry(const DirectoryEntry& entry, bool longFormat);
+
+
+#endif //REDES_1_T1_DIRECTORYLISTING_H
@@ -0,0 +1,42 @@
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+
+#include "FileCheckpoint.h"
+
+bool FileCheckpoint::resume(const string &filePath) {
+    this->done = 0;
+    ifstream file(checkpointPath(filePath));
+    unsigned long savedSize, savedStart, savedLength, savedDone;
+    if (!(file >> savedSize >> savedStart >> savedLength >> savedDone)) {
+        return false;
+    }
+    if (savedSize != this->fileSize || savedStart != this->start || savedLength != this->length ||
+        savedDone > this->length) {
+        return false;
+    }
+
+    // The part file may hold more than the checkpoint (data written after it), but never less.
+    struct stat status;
+    if (stat(partPath(filePath).c_str(), &status) == -1 || static_cast<unsigned long>(status.st_size) < savedDone) {
+        return false;
+    }
+    this->done = savedDone;
+    return true;
+}
+
+bool FileCheckpoint::save(const string &filePath) const {
+    string temporaryPath = checkpointPath(filePath) + ".tmp";
+    {
+        ofstream file(temporaryPath, ios::trunc);
+        file << this->fileSize << " " << this->start << " " << this->length << " " << this->done << endl;
+        if (!file) {
+            return false;
+        }
+    }
+    return rename(temporaryPath.c_str(), checkpointPath(filePath).c_str()) == 0;
+}
+
+void FileCheckpoint::remove(const string &filePath) {
+    std::remove(checkpointPath(filePath).c_str());
+}
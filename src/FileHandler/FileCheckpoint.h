@@ -0,0 +1,43 @@
+#ifndef REDES_1_T1_FILECHECKPOINT_H
+#define REDES_1_T1_FILECHECKPOINT_H
+
+#include <string>
+
+using namespace std;
+
+/// \brief Data received between two checkpoints of a file, in bytes.
+#define CHECKPOINT_INTERVAL (8ul * 1024 * 1024)
+
+/**
+ * @brief Progress of a file (or a slice of it) being received, so an interrupted transfer resumes where it stopped
+ * instead of starting over.
+ *
+ * The data is written to <file>.part and renamed to <file> once complete. The progress is saved to <file>.checkpoint,
+ * only after the data it counts is on the disk.
+ */
+struct FileCheckpoint {
+    /// \brief Size of the whole file on the sender.
+    unsigned long fileSize = 0;
+    /// \brief Offset in the file of the first byte received.
+    unsigned long start = 0;
+    /// \brief Bytes received from start, the rest of the file unless only a slice is received.
+    unsigned long length = 0;
+    /// \brief Bytes already received and written, the size of the part file.
+    unsigned long done = 0;
+
+    /// \brief Continue from the checkpoint of filePath, if it is for the same range of a file of the same size and
+    /// the part file still has its data.
+    /// \return false if there is nothing to resume, in which case done is 0.
+    bool resume(const string& filePath);
+    /// \brief Save the progress of filePath, writing it to a temporary file first so a crash leaves the old one.
+    bool save(const string& filePath) const;
+    /// \brief Remove the checkpoint of filePath, once the file is complete.
+    static void remove(const string& filePath);
+
+    /// \brief Where the data of filePath is written until it is complete.
+    static string partPath(const string& filePath) { return filePath + ".part"; }
+    static string checkpointPath(const string& filePath) { return filePath + ".checkpoint"; }
+};
+
+
+#endif //REDES_1_T1_FILECHECKPOINT_H
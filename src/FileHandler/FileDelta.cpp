@@ -0,0 +1,383 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <openssl/evp.h>
+#include "FileDelta.h"
+
+/// \brief Instructions of a delta.
+#define DELTA_LITERAL 'L'
+#define DELTA_COPY 'C'
+#define DELTA_END 'E'
+
+namespace {
+    void putUint32(vector<char>& output, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            output.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    uint32_t getUint32(const unsigned char *data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+    }
+
+    void blockHash(const void *data, size_t size, unsigned char *hash) {
+        EVP_Digest(data, size, hash, nullptr, EVP_md5(), nullptr);
+    }
+
+    /// \brief The 16 bits of a rolling checksum that index the filter of the encoder.
+    size_t filterIndex(uint32_t weak) {
+        return (weak ^ (weak >> 16)) & 0xFFFF;
+    }
+}
+
+struct DeltaFileHash {
+    EVP_MD_CTX *context;
+
+    DeltaFileHash() : context(EVP_MD_CTX_new()) {
+        if (this->context == nullptr || EVP_DigestInit_ex(this->context, EVP_md5(), nullptr) != 1) {
+            EVP_MD_CTX_free(this->context);
+            throw runtime_error("Could not start a MD5 digest.");
+        }
+    }
+
+    ~DeltaFileHash() {
+        EVP_MD_CTX_free(this->context);
+    }
+
+    void update(const void *data, size_t size) {
+        EVP_DigestUpdate(this->context, data, size);
+    }
+
+    void final(unsigned char *hash) {
+        EVP_DigestFinal_ex(this->context, hash, nullptr);
+    }
+};
+
+size_t deltaBlockSize(size_t fileSize) {
+    auto size = static_cast<size_t>(sqrt(static_cast<double>(fileSize)));
+    // Rounded to a multiple of 1 KiB, so the blocks line up with pages of the file.
+    size = (size + 1023) & ~static_cast<size_t>(1023);
+    return max(DELTA_MIN_BLOCK_SIZE, min(DELTA_MAX_BLOCK_SIZE, size));
+}
+
+void RollingChecksum::reset(const unsigned char *data, size_t size) {
+    this->m_a = 0;
+    this->m_b = 0;
+    this->m_size = static_cast<uint32_t>(size);
+    for (size_t i = 0; i < size; ++i) {
+        this->m_a += data[i];
+        this->m_b += static_cast<uint32_t>(size - i) * data[i];
+    }
+}
+
+void RollingChecksum::roll(unsigned char out, unsigned char in) {
+    this->m_a += static_cast<uint32_t>(in) - out;
+    this->m_b += this->m_a - this->m_size * out;
+}
+
+SignatureWriter::SignatureWriter(const string &filePath, size_t blockSize) :
+        m_file(filePath, blockSize), m_block(blockSize) {}
+
+bool SignatureWriter::produce() {
+    if (!this->m_headerDone) {
+        this->m_headerDone = true;
+        putUint32(this->m_output, static_cast<uint32_t>(this->m_block.size()));
+        return true;
+    }
+
+    size_t size = this->m_file.read(this->m_block.data(), this->m_block.size());
+    if (size == 0) {
+        return false;
+    }
+    RollingChecksum checksum;
+    checksum.reset(reinterpret_cast<const unsigned char *>(this->m_block.data()), size);
+    putUint32(this->m_output, checksum.value());
+    unsigned char hash[DELTA_STRONG_SIZE];
+    blockHash(this->m_block.data(), size, hash);
+    this->m_output.insert(this->m_output.end(), hash, hash + DELTA_STRONG_SIZE);
+    return true;
+}
+
+DeltaEncoder::DeltaEncoder(const string &filePath, const vector<unsigned char> &signatures) :
+        m_seen(1u << 16), m_fileHash(new DeltaFileHash()) {
+    if (signatures.size() < 4) {
+        return;
+    }
+    this->m_blockSize = getUint32(signatures.data());
+    if (this->m_blockSize == 0 || this->m_blockSize > DELTA_MAX_BLOCK_SIZE) {
+        return;
+    }
+
+    size_t blocks = (signatures.size() - 4) / DELTA_SIGNATURE_SIZE;
+    this->m_strong.reserve(blocks * DELTA_STRONG_SIZE);
+    for (size_t i = 0; i < blocks; ++i) {
+        const unsigned char *signature = signatures.data() + 4 + i * DELTA_SIGNATURE_SIZE;
+        uint32_t weak = getUint32(signature);
+        this->m_strong.insert(this->m_strong.end(), signature + 4, signature + DELTA_SIGNATURE_SIZE);
+        this->m_blocks[weak].push_back(static_cast<uint32_t>(i));
+        this->m_seen[filterIndex(weak)] = true;
+    }
+
+    // Room for the window and a read after it, without moving the data at every read.
+    this->m_data.resize(DELTA_READ_SIZE + 2 * DELTA_MAX_LITERAL + this->m_blockSize);
+    this->m_fd = open(filePath.c_str(), O_RDONLY);
+}
+
+DeltaEncoder::~DeltaEncoder() {
+    if (this->m_fd != -1) {
+        close(this->m_fd);
+    }
+}
+
+void DeltaEncoder::fill() {
+    // Only the literal data not sent yet and the window are kept.
+    if (this->m_literalStart > 0) {
+        memmove(this->m_data.data(), this->m_data.data() + this->m_literalStart, this->m_dataEnd - this->m_literalStart);
+        this->m_dataEnd -= this->m_literalStart;
+        this->m_position -= this->m_literalStart;
+        this->m_literalStart = 0;
+    }
+    while (!this->m_fileDone && this->m_dataEnd < this->m_data.size()) {
+        ssize_t size = ::read(this->m_fd, this->m_data.data() + this->m_dataEnd,
+                              min(DELTA_READ_SIZE, this->m_data.size() - this->m_dataEnd));
+        if (size <= 0) {
+            // An error ends the file early, the MD5 of the file then tells the other node the copy is wrong.
+            this->m_fileDone = true;
+            break;
+        }
+        this->m_fileHash->update(this->m_data.data() + this->m_dataEnd, static_cast<size_t>(size));
+        this->m_dataEnd += static_cast<size_t>(size);
+    }
+}
+
+long DeltaEncoder::findBlock() {
+    uint32_t weak = this->m_checksum.value();
+    if (!this->m_seen[filterIndex(weak)]) {
+        return -1;
+    }
+    auto found = this->m_blocks.find(weak);
+    if (found == this->m_blocks.end()) {
+        return -1;
+    }
+
+    unsigned char hash[DELTA_STRONG_SIZE];
+    blockHash(this->m_data.data() + this->m_position, this->m_blockSize, hash);
+    // The block after the last one found is the most likely match, as in an unchanged part of the file.
+    uint32_t next = this->m_copyStart + this->m_copyCount;
+    long match = -1;
+    for (uint32_t block : found->second) {
+        if (memcmp(this->m_strong.data() + block * DELTA_STRONG_SIZE, hash, DELTA_STRONG_SIZE) == 0) {
+            if (match == -1 || block == next) {
+                match = block;
+            }
+            if (block == next) {
+                break;
+            }
+        }
+    }
+    return match;
+}
+
+void DeltaEncoder::emitLiteral(size_t end) {
+    if (end == this->m_literalStart) {
+        return;
+    }
+    this->flushCopy();
+    size_t size = end - this->m_literalStart;
+    this->m_output.push_back(DELTA_LITERAL);
+    putUint32(this->m_output, static_cast<uint32_t>(size));
+    this->m_output.insert(this->m_output.end(), this->m_data.begin() + static_cast<long>(this->m_literalStart),
+                          this->m_data.begin() + static_cast<long>(end));
+    this->m_literalStart = end;
+    this->m_literalBytes += size;
+}
+
+void DeltaEncoder::emitCopy(uint32_t block) {
+    if (this->m_copyCount > 0 && block != this->m_copyStart + this->m_copyCount) {
+        this->flushCopy();
+    }
+    if (this->m_copyCount == 0) {
+        this->m_copyStart = block;
+    }
+    ++this->m_copyCount;
+    this->m_copiedBytes += this->m_blockSize;
+}
+
+void DeltaEncoder::flushCopy() {
+    if (this->m_copyCount == 0) {
+        return;
+    }
+    this->m_output.push_back(DELTA_COPY);
+    putUint32(this->m_output, this->m_copyStart);
+    putUint32(this->m_output, this->m_copyCount);
+    // The next run starts after this one, so findBlock keeps preferring the blocks that follow it.
+    this->m_copyStart += this->m_copyCount;
+    this->m_copyCount = 0;
+}
+
+bool DeltaEncoder::produce() {
+    if (this->m_finished || !this->isOpen()) {
+        return false;
+    }
+
+    // Stops once there is something to hand out, so the output stays around the size of an instruction.
+    while (this->m_output.empty()) {
+        if (this->m_dataEnd - this->m_position <= this->m_blockSize && !this->m_fileDone) {
+            this->fill();
+        }
+
+        if (this->m_dataEnd - this->m_position < this->m_blockSize) {
+            // The end of the file, shorter than a block, is sent as it is.
+            this->emitLiteral(this->m_dataEnd);
+            this->m_position = this->m_dataEnd;
+            if (this->m_output.empty()) {
+                this->flushCopy();
+            }
+            if (this->m_literalStart == this->m_dataEnd && this->m_copyCount == 0) {
+                this->m_output.push_back(DELTA_END);
+                unsigned char hash[DELTA_STRONG_SIZE];
+                this->m_fileHash->final(hash);
+                this->m_output.insert(this->m_output.end(), hash, hash + DELTA_STRONG_SIZE);
+                this->m_finished = true;
+            }
+            break;
+        }
+
+        if (!this->m_checksumValid) {
+            this->m_checksum.reset(this->m_data.data() + this->m_position, this->m_blockSize);
+            this->m_checksumValid = true;
+        }
+        long block = this->findBlock();
+        if (block >= 0) {
+            this->emitLiteral(this->m_position);
+            this->emitCopy(static_cast<uint32_t>(block));
+            this->m_position += this->m_blockSize;
+            this->m_literalStart = this->m_position;
+            this->m_checksumValid = false;
+            continue;
+        }
+
+        if (this->m_position + this->m_blockSize < this->m_dataEnd) {
+            this->m_checksum.roll(this->m_data[this->m_position], this->m_data[this->m_position + this->m_blockSize]);
+        }
+        else {
+            this->m_checksumValid = false;
+        }
+        ++this->m_position;
+        if (this->m_position - this->m_literalStart >= DELTA_MAX_LITERAL) {
+            this->emitLiteral(this->m_position);
+        }
+    }
+    return true;
+}
+
+DeltaDecoder::DeltaDecoder(const string &basisPath, size_t blockSize, const string &outputPath) :
+        m_blockSize(blockSize), m_output(outputPath), m_block(blockSize), m_fileHash(new DeltaFileHash()) {
+    this->m_pending.reserve(DELTA_MAX_LITERAL);
+    this->m_basis = open(basisPath.c_str(), O_RDONLY);
+    this->m_failed = this->m_basis == -1 || !this->m_output.isOpen();
+}
+
+DeltaDecoder::~DeltaDecoder() {
+    if (this->m_basis != -1) {
+        close(this->m_basis);
+    }
+}
+
+size_t DeltaDecoder::headerSize(unsigned char instruction) {
+    switch (instruction) {
+        case DELTA_LITERAL:
+            return 1 + 4;
+        case DELTA_COPY:
+            return 1 + 4 + 4;
+        case DELTA_END:
+            return 1 + DELTA_STRONG_SIZE;
+        default:
+            return 0;
+    }
+}
+
+bool DeltaDecoder::output(const char *data, size_t size) {
+    this->m_fileHash->update(data, size);
+    // Small literals and short blocks are gathered, every write of AsyncFileWriter copies its data to a buffer of its own.
+    this->m_pending.insert(this->m_pending.end(), data, data + size);
+    if (this->m_pending.size() >= DELTA_MAX_LITERAL) {
+        bool written = this->m_output.write(this->m_pending.data(), this->m_pending.size());
+        this->m_pending.clear();
+        return written;
+    }
+    return true;
+}
+
+bool DeltaDecoder::execute() {
+    const unsigned char *header = this->m_header;
+    if (header[0] == DELTA_LITERAL) {
+        this->m_literalLeft = getUint32(header + 1);
+        return true;
+    }
+    if (header[0] == DELTA_END) {
+        unsigned char hash[DELTA_STRONG_SIZE];
+        this->m_fileHash->final(hash);
+        this->m_finished = true;
+        this->m_verified = memcmp(hash, header + 1, DELTA_STRONG_SIZE) == 0;
+        return true;
+    }
+
+    uint32_t first = getUint32(header + 1);
+    uint32_t count = getUint32(header + 5);
+    for (uint32_t block = first; block - first < count; ++block) {
+        ssize_t size = pread(this->m_basis, this->m_block.data(), this->m_blockSize,
+                             static_cast<off_t>(block) * static_cast<off_t>(this->m_blockSize));
+        // Only the last block of the old file may be short.
+        if (size <= 0 || !this->output(this->m_block.data(), static_cast<size_t>(size))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaDecoder::write(const unsigned char *data, size_t size) {
+    while (size > 0 && !this->m_failed) {
+        if (this->m_finished) {
+            // Nothing may follow the end of the delta.
+            this->m_failed = true;
+            break;
+        }
+        if (this->m_literalLeft > 0) {
+            size_t count = min(size, this->m_literalLeft);
+            this->m_failed = !this->output(reinterpret_cast<const char *>(data), count);
+            this->m_literalLeft -= count;
+            data += count;
+            size -= count;
+            continue;
+        }
+
+        if (this->m_headerSize == 0 && headerSize(*data) == 0) {
+            this->m_failed = true;
+            break;
+        }
+        size_t needed = headerSize(this->m_headerSize == 0 ? *data : this->m_header[0]) - this->m_headerSize;
+        size_t count = min(size, needed);
+        memcpy(this->m_header + this->m_headerSize, data, count);
+        this->m_headerSize += count;
+        data += count;
+        size -= count;
+        if (count == needed) {
+            this->m_headerSize = 0;
+            this->m_failed = !this->execute();
+        }
+    }
+    return !this->m_failed;
+}
+
+bool DeltaDecoder::finish() {
+    if (!this->m_pending.empty() && !this->m_failed) {
+        this->m_failed = !this->m_output.write(this->m_pending.data(), this->m_pending.size());
+        this->m_pending.clear();
+    }
+    bool written = this->m_output.finish();
+    return written && !this->m_failed && this->m_finished && this->m_verified && this->m_literalLeft == 0;
+}
@@ -0,0 +1,163 @@
+#ifndef REDES_1_T1_FILEDELTA_H
+#define REDES_1_T1_FILEDELTA_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AsyncFileIO.h"
+#include "ByteProducer.h"
+
+using namespace std;
+
+/// \brief Smallest and largest blocks compared by a delta, files in between use blocks of about the square root of
+/// their size, so the signatures and the work of matching both grow slowly with the file.
+#define DELTA_MIN_BLOCK_SIZE static_cast<size_t>(2048)
+#define DELTA_MAX_BLOCK_SIZE static_cast<size_t>(64 * 1024)
+/// \brief MD5 of a block, which confirms a match of the rolling checksum.
+#define DELTA_STRONG_SIZE static_cast<size_t>(16)
+/// \brief Rolling checksum and MD5 of a block.
+#define DELTA_SIGNATURE_SIZE (4 + DELTA_STRONG_SIZE)
+/// \brief Longest run of literal data in a single instruction.
+#define DELTA_MAX_LITERAL static_cast<size_t>(64 * 1024)
+/// \brief Data read from the file at once by the encoder.
+#define DELTA_READ_SIZE static_cast<size_t>(1024 * 1024)
+
+/// \brief Block size of the signatures of a file with the given size.
+size_t deltaBlockSize(size_t fileSize);
+
+/// \brief MD5 of a whole file, computed as its data goes by.
+struct DeltaFileHash;
+
+/**
+ * @brief The rsync rolling checksum of a window of data, updated in constant time when the window moves by a byte.
+ */
+class RollingChecksum {
+public:
+    /// \brief Start over with the window of size bytes at data.
+    void reset(const unsigned char *data, size_t size);
+    /// \brief Move the window a byte forward, out leaving it and in entering it.
+    void roll(unsigned char out, unsigned char in);
+    uint32_t value() const { return (m_a & 0xFFFF) | (m_b << 16); }
+
+private:
+    uint32_t m_a = 0;
+    uint32_t m_b = 0;
+    uint32_t m_size = 0;
+};
+
+/**
+ * @brief Signatures of a file, produced by the node that has a copy of it: the block size (32 bits), then the
+ * rolling checksum (32 bits) and the MD5 of each block.
+ */
+class SignatureWriter: public ByteProducer {
+public:
+    SignatureWriter(const string& filePath, size_t blockSize);
+
+protected:
+    bool produce() override;
+
+private:
+    AsyncFileReader m_file;
+    vector<char> m_block;
+    bool m_headerDone = false;
+};
+
+/**
+ * @brief Instructions that rebuild a file from the copy the other node has: literal data ('L', a 32 bit size and
+ * the data), runs of blocks of the copy ('C', the 32 bit index of the first block and the 32 bit count) and, at the
+ * end, the MD5 of the whole file ('E' and the MD5), which catches the blocks wrongly taken as equal.
+ */
+class DeltaEncoder: public ByteProducer {
+public:
+    /// \param signatures As produced by SignatureWriter.
+    DeltaEncoder(const string& filePath, const vector<unsigned char>& signatures);
+    ~DeltaEncoder() override;
+
+    bool isOpen() const { return m_fd != -1; }
+    /// \brief Bytes of the file sent as literal data and taken from the copy of the other node so far.
+    size_t literalBytes() const { return m_literalBytes; }
+    size_t copiedBytes() const { return m_copiedBytes; }
+
+protected:
+    bool produce() override;
+
+private:
+    int m_fd = -1;
+    size_t m_blockSize = 0;
+    vector<unsigned char> m_strong;
+    /// \brief Blocks by rolling checksum, and a bit per value of its hashed 16 bits, to skip most lookups.
+    unordered_map<uint32_t, vector<uint32_t>> m_blocks;
+    vector<bool> m_seen;
+
+    /// \brief Part of the file being matched, m_data[0] is at m_base in the file.
+    vector<unsigned char> m_data;
+    size_t m_dataEnd = 0;
+    bool m_fileDone = false;
+    /// \brief Start of the window and of the literal data not sent yet, in m_data.
+    size_t m_position = 0;
+    size_t m_literalStart = 0;
+    RollingChecksum m_checksum;
+    bool m_checksumValid = false;
+    /// \brief Run of blocks found but not sent yet, merged with the next one if it follows it.
+    uint32_t m_copyStart = 0;
+    uint32_t m_copyCount = 0;
+    bool m_finished = false;
+
+    unique_ptr<DeltaFileHash> m_fileHash;
+
+    size_t m_literalBytes = 0;
+    size_t m_copiedBytes = 0;
+
+    /// \brief Read more of the file, dropping the data already sent.
+    void fill();
+    /// \return The index of a block equal to the window, -1 if none.
+    long findBlock();
+    void emitLiteral(size_t end);
+    void emitCopy(uint32_t block);
+    void flushCopy();
+};
+
+/**
+ * @brief Rebuilds a file from a copy of its old version and the instructions of a DeltaEncoder, as they arrive.
+ */
+class DeltaDecoder {
+public:
+    /// \param basisPath The old version of the file, the one the signatures were made from.
+    /// \param outputPath Where the new version is written.
+    DeltaDecoder(const string& basisPath, size_t blockSize, const string& outputPath);
+    ~DeltaDecoder();
+
+    /// \brief Apply the next bytes of the instructions.
+    /// \return false if they are invalid or the file couldn't be written.
+    bool write(const unsigned char *data, size_t size);
+    /// \brief Wait for the writes to finish.
+    /// \return true if the end of the instructions was received and the new file has the expected MD5.
+    bool finish();
+
+private:
+    int m_basis = -1;
+    size_t m_blockSize;
+    AsyncFileWriter m_output;
+    vector<char> m_block;
+    /// \brief Output not written yet.
+    vector<char> m_pending;
+    /// \brief Instruction being read, and the bytes of its header received so far.
+    unsigned char m_header[1 + DELTA_STRONG_SIZE];
+    size_t m_headerSize = 0;
+    size_t m_literalLeft = 0;
+    bool m_failed = false;
+    bool m_finished = false;
+    bool m_verified = false;
+
+    unique_ptr<DeltaFileHash> m_fileHash;
+
+    /// \return The size of the header of the instruction starting with the given byte, 0 if it is invalid.
+    static size_t headerSize(unsigned char instruction);
+    bool execute();
+    bool output(const char *data, size_t size);
+};
+
+
+#endif //REDES_1_T1_FILEDELTA_H
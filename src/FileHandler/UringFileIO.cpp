@@ -0,0 +1,153 @@
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "UringFileIO.h"
+
+UringFileIO::UringFileIO(size_t depth) : AsyncFileIO(depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    this->m_ring = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(depth), &params));
+    if (this->m_ring < 0) {
+        throw runtime_error("Could not set up io_uring: " + string(strerror(errno)));
+    }
+
+    this->m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    this->m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // Newer kernels map both rings with a single call.
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        this->m_sqRingSize = max(this->m_sqRingSize, this->m_cqRingSize);
+    }
+
+    this->m_sqRing = mmap(nullptr, this->m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          this->m_ring, IORING_OFF_SQ_RING);
+    if (this->m_sqRing == MAP_FAILED) {
+        this->m_sqRing = nullptr;
+        this->release();
+        throw runtime_error("Could not map the io_uring submission ring.");
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        this->m_cqRing = this->m_sqRing;
+    }
+    else {
+        this->m_cqRing = mmap(nullptr, this->m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              this->m_ring, IORING_OFF_CQ_RING);
+        if (this->m_cqRing == MAP_FAILED) {
+            this->m_cqRing = nullptr;
+            this->release();
+            throw runtime_error("Could not map the io_uring completion ring.");
+        }
+    }
+
+    this->m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, this->m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      this->m_ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        this->release();
+        throw runtime_error("Could not map the io_uring submission entries.");
+    }
+    this->m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+    auto sq = static_cast<char *>(this->m_sqRing);
+    this->m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    this->m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    this->m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    this->m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char *>(this->m_cqRing);
+    this->m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    this->m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    this->m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    this->m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // The kernel may round the number of entries up, but never down.
+    this->m_depth = min(this->m_depth, static_cast<size_t>(params.sq_entries));
+}
+
+UringFileIO::~UringFileIO() {
+    this->release();
+}
+
+void UringFileIO::release() {
+    if (this->m_sqes != nullptr) {
+        munmap(this->m_sqes, this->m_sqesSize);
+        this->m_sqes = nullptr;
+    }
+    if (this->m_cqRing != nullptr && this->m_cqRing != this->m_sqRing) {
+        munmap(this->m_cqRing, this->m_cqRingSize);
+    }
+    this->m_cqRing = nullptr;
+    if (this->m_sqRing != nullptr) {
+        munmap(this->m_sqRing, this->m_sqRingSize);
+        this->m_sqRing = nullptr;
+    }
+    if (this->m_ring != -1) {
+        // Closing the ring waits for the operations still in flight.
+        close(this->m_ring);
+        this->m_ring = -1;
+    }
+}
+
+bool UringFileIO::submitRead(int fd, char *buffer, size_t size, off_t offset, unsigned long tag) {
+    return this->submit(IORING_OP_READ, fd, buffer, size, offset, tag);
+}
+
+bool UringFileIO::submitWrite(int fd, const char *buffer, size_t size, off_t offset, unsigned long tag) {
+    return this->submit(IORING_OP_WRITE, fd, buffer, size, offset, tag);
+}
+
+bool UringFileIO::submit(unsigned char opcode, int fd, const char *buffer, size_t size, off_t offset,
+                         unsigned long tag) {
+    if (this->m_inFlight >= this->m_depth) {
+        return false;
+    }
+
+    // Only we write the tail, the kernel moves the head as it consumes the entries.
+    unsigned tail = *this->m_sqTail;
+    unsigned index = tail & this->m_sqMask;
+    io_uring_sqe *sqe = &this->m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<unsigned long>(buffer);
+    sqe->len = static_cast<unsigned>(size);
+    sqe->off = static_cast<unsigned long>(offset);
+    sqe->user_data = tag;
+    this->m_sqArray[index] = index;
+    __atomic_store_n(this->m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    this->m_toSubmit++;
+    this->m_inFlight++;
+    return true;
+}
+
+size_t UringFileIO::complete(vector<FileCompletion> &completions, bool wait) {
+    unsigned head = *this->m_cqHead;
+    bool ready = head != __atomic_load_n(this->m_cqTail, __ATOMIC_ACQUIRE);
+    wait = wait && !ready && this->m_inFlight > 0;
+
+    if (this->m_toSubmit > 0 || wait) {
+        long submitted = syscall(__NR_io_uring_enter, this->m_ring, this->m_toSubmit, wait ? 1u : 0u,
+                                 wait ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+        if (submitted > 0) {
+            this->m_toSubmit -= static_cast<unsigned>(submitted);
+        }
+    }
+
+    size_t count = 0;
+    unsigned tail = __atomic_load_n(this->m_cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        const io_uring_cqe &cqe = this->m_cqes[head & this->m_cqMask];
+        completions.push_back({static_cast<unsigned long>(cqe.user_data), static_cast<long>(cqe.res)});
+        head++;
+        count++;
+    }
+    __atomic_store_n(this->m_cqHead, head, __ATOMIC_RELEASE);
+
+    this->m_inFlight -= count;
+    return count;
+}
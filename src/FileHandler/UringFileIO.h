@@ -0,0 +1,53 @@
+#ifndef REDES_1_T1_URINGFILEIO_H
+#define REDES_1_T1_URINGFILEIO_H
+
+#include "AsyncFileIO.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * @brief Engine that submits reads and writes to the kernel through the submission and completion rings of io_uring,
+ * mapped directly without liburing.
+ *
+ * Submissions are only handed to the kernel by complete, so a whole batch of them costs a single system call.
+ */
+class UringFileIO: public AsyncFileIO {
+public:
+    /// \brief Set up the rings, throws runtime_error if the kernel doesn't support (or allow) io_uring.
+    explicit UringFileIO(size_t depth);
+    ~UringFileIO() override;
+
+    bool submitRead(int fd, char *buffer, size_t size, off_t offset, unsigned long tag) override;
+    bool submitWrite(int fd, const char *buffer, size_t size, off_t offset, unsigned long tag) override;
+    size_t complete(vector<FileCompletion>& completions, bool wait) override;
+
+private:
+    int m_ring = -1;
+
+    void *m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    void *m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned *m_sqHead = nullptr;
+    unsigned *m_sqTail = nullptr;
+    unsigned *m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    io_uring_cqe *m_cqes = nullptr;
+    unsigned m_cqMask = 0;
+
+    /// \brief Entries written to the submission ring but not handed to the kernel yet.
+    unsigned m_toSubmit = 0;
+
+    /// \brief Unmap the rings and close the io_uring file descriptor.
+    void release();
+    bool submit(unsigned char opcode, int fd, const char *buffer, size_t size, off_t offset, unsigned long tag);
+};
+
+
+#endif //REDES_1_T1_URINGFILEIO_H
@@ -1,5 +1,8 @@
+#include <glob.h>
 #include <sys/statvfs.h>
 #include <unistd.h>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <sys/stat.h>
 #include <sstream>
@@ -62,3 +65,83 @@ bool hasWritePermission(const string& dirPath) {
 bool fileExists(const string& filePath) {
     return access(filePath.c_str(), F_OK) != -1;
 }
+
+vector<string> matchFiles(const string& pattern) {
+    vector<string> files;
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            struct stat status;
+            if (stat(matches.gl_pathv[i], &status) == 0 && S_ISREG(status.st_mode)) {
+                files.emplace_back(matches.gl_pathv[i]);
+            }
+        }
+    }
+    globfree(&matches);
+    return files;
+}
+
+string normalizePath(const string& path) {
+    vector<string> components;
+    istringstream parts(path);
+    string part;
+    while (getline(parts, part, '/')) {
+        if (part.empty() || part == ".") {
+            continue;
+        }
+        if (part == "..") {
+            // The parent of the root is the root.
+            if (!components.empty()) {
+                components.pop_back();
+            }
+            continue;
+        }
+        components.push_back(part);
+    }
+
+    string normalized;
+    for (const string& component : components) {
+        normalized += "/" + component;
+    }
+    return normalized.empty() ? "/" : normalized;
+}
+
+pair<bool, string> canEnterDirectory(const string& dirPath) {
+    struct stat status;
+    if (stat(dirPath.c_str(), &status) == -1) {
+        return {false, dirPath + ": " + strerror(errno)};
+    }
+    if (!S_ISDIR(status.st_mode)) {
+        return {false, dirPath + ": " + strerror(ENOTDIR)};
+    }
+    if (access(dirPath.c_str(), X_OK) == -1) {
+        return {false, dirPath + ": " + strerror(errno)};
+    }
+    return {true, ""};
+}
+
+pair<bool, string> makeDirectory(const string& dirPath, bool parents) {
+    auto failure = [&dirPath](int error) {
+        return pair<bool, string>(false, "cannot create directory '" + dirPath + "': " + strerror(error));
+    };
+    if (!parents) {
+        if (mkdir(dirPath.c_str(), 0777) == -1) {
+            return failure(errno);
+        }
+        return {true, ""};
+    }
+
+    // Each missing directory of the path is created in turn, the existing ones are only checked.
+    for (size_t end = dirPath.find('/', 1); ; end = dirPath.find('/', end + 1)) {
+        string path = dirPath.substr(0, end);
+        struct stat status;
+        if (mkdir(path.c_str(), 0777) == -1 &&
+            (errno != EEXIST || stat(path.c_str(), &status) == -1 || !S_ISDIR(status.st_mode))) {
+            return failure(errno == EEXIST ? ENOTDIR : errno);
+        }
+        if (end == string::npos) {
+            break;
+        }
+    }
+    return {true, ""};
+}
@@ -2,6 +2,7 @@
 #define REDES_1_T1_FILEHANDLER_H
 
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -20,4 +21,19 @@ bool hasWritePermission(const string& dirPath);
 
 bool fileExists(const string& filePath);
 
+/// \brief Resolve the '.' and '..' components and the repeated slashes of an absolute path, without following links
+/// (as the cd of a shell).
+string normalizePath(const string& path);
+
+/// \brief Check that a path is a directory the current user can enter.
+/// \return false and the reason if it isn't.
+pair<bool, string> canEnterDirectory(const string& dirPath);
+
+/// \brief Create a directory, and its missing parents if parents is set (as mkdir -p).
+/// \return false and the reason if it couldn't be created.
+pair<bool, string> makeDirectory(const string& dirPath, bool parents);
+
+/// \brief The regular files whose paths match a shell pattern (e.g. /tmp/*.txt), sorted.
+vector<string> matchFiles(const string& pattern);
+
 #endif //REDES_1_T1_FILEHANDLER_H
@@ -0,0 +1,100 @@
+#include <cstring>
+#include "Crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#endif
+
+/// \brief Reflected CRC-32C polynomial.
+#define CRC32C_POLYNOMIAL 0x82F63B78u
+
+/**
+ * @brief Tables of the slice-by-8 algorithm: table[0] is the classic byte table, table[k][b] is the crc of the byte b
+ * followed by k zero bytes, so 8 bytes are folded with 8 independent lookups.
+ */
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (uint32_t byte = 0; byte < 256; byte++) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+            }
+            this->table[0][byte] = crc;
+        }
+        for (uint32_t byte = 0; byte < 256; byte++) {
+            for (int slice = 1; slice < 8; slice++) {
+                uint32_t previous = this->table[slice - 1][byte];
+                this->table[slice][byte] = (previous >> 8) ^ this->table[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+static const Crc32cTables tables;
+
+uint32_t crc32cSoftware(const unsigned char *data, size_t size, uint32_t crc) {
+    const uint32_t (*table)[256] = tables.table;
+    crc = ~crc;
+
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, data, sizeof(low));
+        memcpy(&high, data + 4, sizeof(high));
+        // The words are read little endian, like the bytes are consumed by the reflected algorithm.
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xFF];
+    }
+
+    return ~crc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(const unsigned char *data, size_t size, uint32_t crc) {
+    crc = ~crc;
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (size-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return ~crc;
+}
+#endif
+
+bool crc32cHardwareSupported() {
+#ifdef CRC32C_X86
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(const unsigned char *data, size_t size, uint32_t crc) {
+#ifdef CRC32C_X86
+    if (crc32cHardwareSupported()) {
+        return crc32cHardware(data, size, crc);
+    }
+#endif
+    return crc32cSoftware(data, size, crc);
+}
@@ -0,0 +1,20 @@
+#ifndef REDES_1_T1_CRC32C_H
+#define REDES_1_T1_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief CRC-32C (Castagnoli) of size bytes of data, continuing from a previous crc (0 to start).
+ *
+ * Uses the SSE4.2 crc32 instruction when the processor has it, and crc32cSoftware otherwise.
+ */
+uint32_t crc32c(const unsigned char *data, size_t size, uint32_t crc = 0);
+
+/// \brief Table driven (slice-by-8) CRC-32C, for processors without SSE4.2.
+uint32_t crc32cSoftware(const unsigned char *data, size_t size, uint32_t crc = 0);
+
+/// \brief true if crc32c uses the crc32 instruction.
+bool crc32cHardwareSupported();
+
+#endif //REDES_1_T1_CRC32C_H
@@ -1,6 +1,9 @@
+#include <cstring>
 #include <vector>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
+#include "Crc32c.h"
 #include "Message.h"
 #include "../Network/NetworkNode.h"
 
@@ -12,6 +15,10 @@ string toString(MessageType messageType) {
             return "ACK";
         case MessageType::NACK:
             return "NACK";
+        case MessageType::SACK:
+            return "SACK";
+        case MessageType::NEGOTIATE:
+            return "NEGOTIATE";
         case MessageType::ERROR:
             return "ERROR";
         case MessageType::CD:
@@ -30,6 +37,14 @@ string toString(MessageType messageType) {
             return "FILE_DESCRIPTOR";
         case MessageType::PUT:
             return "PUT";
+        case MessageType::GLOB:
+            return "GLOB";
+        case MessageType::SIGNATURE:
+            return "SIGNATURE";
+        case MessageType::DELTA:
+            return "DELTA";
+        case MessageType::CHUNKS:
+            return "CHUNKS";
         case MessageType::END:
             return "END";
         case MessageType::INVALID:
@@ -39,104 +54,219 @@ string toString(MessageType messageType) {
     }
 }
 
-Message::Message(const C_BYTE *bytesMessage) {
-    size_t messageIdx = 1;
+Message::Message(MessageType type, unsigned long sequenceId, vector<C_BYTE> &&data) :
+        m_sequenceId(static_cast<uint32_t>(sequenceId)), m_type(type) {
+    if (data.size() > MAX_DATA_SIZE && data.size() <= EXTENDED_MAX_DATA_SIZE) {
+        // Already on the heap, keep it there.
+        this->m_largeData = move(data);
+        this->m_dataSize = static_cast<uint16_t>(this->m_largeData.size());
+    }
+    else {
+        this->setData(data.data(), data.size());
+    }
+    this->m_checksum = this->calculateChecksum();
+}
 
-    C_BYTE sizeSequence = bytesMessage[messageIdx++];
-    this->m_size = sizeSequence >> 2;
+Message::Message(MessageType type, unsigned long sequenceId, const C_BYTE *data, size_t size) :
+        m_sequenceId(static_cast<uint32_t>(sequenceId)), m_type(type) {
+    this->setData(data, size);
+    this->m_checksum = this->calculateChecksum();
+}
 
-    C_BYTE sequenceType = bytesMessage[messageIdx++];
-    this->m_sequenceId = (sizeSequence & 0b00000011) << 2 | sequenceType >> 6;
-    this->m_type = static_cast<MessageType>(sequenceType & 0b00111111);
+Message::Message(MessageType type, unsigned long sequenceId, unsigned long data) :
+        m_sequenceId(static_cast<uint32_t>(sequenceId)), m_type(type) {
+    C_BYTE bytes[sizeof(unsigned long)];
+    size_t size = 0;
+    do {
+        bytes[sizeof(bytes) - ++size] = static_cast<C_BYTE>(data & 0xFF);
+        data >>= BYTE;
+    } while (data > 0);
+    this->setData(bytes + sizeof(bytes) - size, size);
+    this->m_checksum = this->calculateChecksum();
+}
 
-    size_t dataSize = this->getSize() - MIN_SIZE;
-    if (dataSize > MAX_DATA_SIZE) {
-        logger->error("Received an invalid message with size: " + to_string(dataSize));
-        this->constructionError = true;
-    }
-    else {
-        this->m_data.reserve(dataSize);
-        for (int _ = 0; _ < dataSize; _++) {
-            this->m_data.push_back(bytesMessage[messageIdx++]);
+Message::Message(const C_BYTE *bytesMessage, size_t size) {
+    if (bytesMessage[0] == static_cast<C_BYTE>(NetworkNode::message_delimiter ^ EXTENDED_DELIMITER_MASK)) {
+        this->m_extended = true;
+        if (size < EXTENDED_MIN_SIZE) {
+            Logger::getInstance()->error("Received an extended message smaller than its header: " + to_string(size));
+            this->constructionError = true;
+            return;
         }
-    }
 
-    calculateParity();
-    if (this->m_parity != bytesMessage[messageIdx++]) {
-        logger->warn("Invalid parity received from: " + static_cast<string>(*this));
-        this->constructionError = true;
+        this->m_type = static_cast<MessageType>(bytesMessage[1] & 0b00111111);
+        this->m_crc = (bytesMessage[1] & EXTENDED_CRC_FLAG) != 0;
+        this->m_sequenceId = static_cast<uint32_t>(bytesMessage[2]) << 24 |
+                             static_cast<uint32_t>(bytesMessage[3]) << 16 |
+                             static_cast<uint32_t>(bytesMessage[4]) << 8 | bytesMessage[5];
+        size_t dataSize = static_cast<size_t>(bytesMessage[6]) << 8 | bytesMessage[7];
+        size_t trailerSize = this->m_crc ? CRC_TRAILER_SIZE : 1;
+        if (EXTENDED_HEADER_SIZE + dataSize + trailerSize > size) {
+            Logger::getInstance()->error("Received an invalid extended message with size: " + to_string(dataSize));
+            this->constructionError = true;
+            return;
+        }
+        this->setData(bytesMessage + EXTENDED_HEADER_SIZE, dataSize);
+
+        this->m_checksum = this->calculateChecksum();
+        const C_BYTE *trailer = bytesMessage + EXTENDED_HEADER_SIZE + dataSize;
+        uint32_t received = trailer[0];
+        if (this->m_crc) {
+            received = static_cast<uint32_t>(trailer[0]) << 24 | static_cast<uint32_t>(trailer[1]) << 16 |
+                       static_cast<uint32_t>(trailer[2]) << 8 | trailer[3];
+        }
+        if (this->m_checksum != received) {
+            Logger::getInstance()->warn("Invalid checksum received from: " + static_cast<string>(*this));
+            this->constructionError = true;
+        }
+        return;
     }
-}
 
-T_BYTE Message::calculateParity() {
-    this->m_parity = 0b0;
-//    T_BYTE parity = 0b00000000;
-    T_BYTE parity = NetworkNode::message_delimiter;
+    // Delimiter, 6 bits of size, 4 bits of sequence id and 6 bits of type.
+    size_t messageSize = bytesMessage[1] >> 2;
+    this->m_sequenceId = static_cast<uint32_t>((bytesMessage[1] & 0b00000011) << 2 | bytesMessage[2] >> 6);
+    this->m_type = static_cast<MessageType>(bytesMessage[2] & 0b00111111);
 
-    auto vectorMessage = this->toByteVector();
-    for (const auto &byte: vectorMessage) {
-        parity = parity ^ byte;
+    if (messageSize < MIN_SIZE || messageSize > size) {
+        Logger::getInstance()->error("Received an invalid message with size: " + to_string(messageSize));
+        this->constructionError = true;
+        return;
     }
+    size_t dataSize = messageSize - MIN_SIZE;
+    this->setData(bytesMessage + 3, dataSize);
 
-    this->m_parity = parity;
-    return parity;
+    this->m_checksum = this->calculateChecksum();
+    if (this->m_checksum != bytesMessage[3 + dataSize]) {
+        Logger::getInstance()->warn("Invalid parity received from: " + static_cast<string>(*this));
+        this->constructionError = true;
+    }
 }
 
-vector<T_BYTE> Message::toByteVector() {
-    vector<T_BYTE> vectorMessage;
-    vectorMessage.reserve(this->getSize());
+void Message::setData(const C_BYTE *data, size_t size) {
+    if (size > EXTENDED_MAX_DATA_SIZE) {
+        Logger::getInstance()->error("Trying to create a message with size: " + to_string(size) +
+                                     " content will be truncated.");
+        size = EXTENDED_MAX_DATA_SIZE;
+    }
 
-    // TODO: Change back to this->m_delimiter.
-    if (DEVICE == "lo") {
-        vectorMessage.emplace_back(~NetworkNode::message_delimiter);
+    this->m_dataSize = static_cast<uint16_t>(size);
+    if (size > MAX_DATA_SIZE) {
+        this->m_largeData.assign(data, data + size);
     }
     else {
-        vectorMessage.emplace_back(NetworkNode::message_delimiter);
+        this->m_largeData.clear();
+        memcpy(this->m_inlineData, data, size);
     }
+}
 
-    string sizeSequenceType = this->m_size.to_string();
-    sizeSequenceType += this->m_sequenceId.to_string();
-    sizeSequenceType += this->getTypeAsBitset().to_string();
-
-    T_BYTE byte1(sizeSequenceType.substr(0, 8));
-    T_BYTE byte2(sizeSequenceType.substr(8, 8));
-    vectorMessage.push_back(byte1);
-    vectorMessage.push_back(byte2);
+size_t Message::encodeHeader(C_BYTE *buffer) const {
+    // TODO: Change back to this->m_delimiter.
+    C_BYTE delimiter = NetworkNode::echo_transport ? static_cast<C_BYTE>(~NetworkNode::message_delimiter) :
+                                                     static_cast<C_BYTE>(NetworkNode::message_delimiter);
 
-    for (const auto& dataByte : this->m_data) {
-        vectorMessage.emplace_back(dataByte);
+    if (this->m_extended) {
+        buffer[0] = delimiter ^ EXTENDED_DELIMITER_MASK;
+        buffer[1] = static_cast<C_BYTE>(this->m_type) | (this->m_crc ? EXTENDED_CRC_FLAG : 0);
+        buffer[2] = static_cast<C_BYTE>(this->m_sequenceId >> 24);
+        buffer[3] = static_cast<C_BYTE>(this->m_sequenceId >> 16);
+        buffer[4] = static_cast<C_BYTE>(this->m_sequenceId >> 8);
+        buffer[5] = static_cast<C_BYTE>(this->m_sequenceId);
+        buffer[6] = static_cast<C_BYTE>(this->m_dataSize >> 8);
+        buffer[7] = static_cast<C_BYTE>(this->m_dataSize);
+        return EXTENDED_HEADER_SIZE;
     }
 
-    vectorMessage.push_back(this->m_parity);
+    // 6 bits of size, 4 bits of sequence id and 6 bits of type.
+    size_t size = this->getSize() & 0b111111;
+    buffer[0] = delimiter;
+    buffer[1] = static_cast<C_BYTE>(size << 2 | (this->m_sequenceId & 0b1100) >> 2);
+    buffer[2] = static_cast<C_BYTE>((this->m_sequenceId & 0b0011) << 6 |
+                                    (static_cast<C_BYTE>(this->m_type) & 0b111111));
+    return 3;
+}
 
-    return vectorMessage;
+uint32_t Message::calculateChecksum() const {
+    C_BYTE header[EXTENDED_HEADER_SIZE];
+    size_t headerSize = this->encodeHeader(header);
+    if (this->m_crc) {
+        // On echo transports each node sends its own delimiter (see NetworkNode::echo_transport), so the CRC covers
+        // the same one on both, unlike the parity, where the delimiter of the receiver cancels the one received.
+        header[0] = static_cast<C_BYTE>(BEGIN_DELIMITER ^ EXTENDED_DELIMITER_MASK);
+        return crc32c(this->getDataBytes(), this->m_dataSize, crc32c(header, headerSize));
+    }
+
+    C_BYTE parity = static_cast<C_BYTE>(NetworkNode::message_delimiter);
+    for (size_t i = 0; i < headerSize; i++) {
+        parity ^= header[i];
+    }
+    const C_BYTE *data = this->getDataBytes();
+    for (size_t i = 0; i < this->m_dataSize; i++) {
+        parity ^= data[i];
+    }
+    return parity;
 }
 
-vector<C_BYTE> Message::toCharVector() {
-    vector<C_BYTE> vectorMessage;
-    vectorMessage.reserve(64);
+size_t Message::encode(C_BYTE *buffer, size_t capacity) const {
+    size_t frameSize = this->getFrameSize();
+    if (capacity < frameSize) {
+        return 0;
+    }
 
-    auto byteMessage = this->toByteVector();
-    for (const auto& byte : byteMessage) {
-        vectorMessage.push_back(static_cast<C_BYTE>(byte.to_ulong()));
+    size_t index = this->encodeHeader(buffer);
+    memcpy(buffer + index, this->getDataBytes(), this->m_dataSize);
+    index += this->m_dataSize;
+    if (this->m_crc) {
+        for (int shift = 24; shift >= 0; shift -= BYTE) {
+            buffer[index++] = static_cast<C_BYTE>(this->m_checksum >> shift);
+        }
+    }
+    else {
+        buffer[index++] = static_cast<C_BYTE>(this->m_checksum);
     }
 
     // fill the message with trash to get to the minimum of 64 bytes.
-    if (vectorMessage.size() < 64) {
-        vectorMessage.insert(vectorMessage.end(), 64 - vectorMessage.size(), 0);
+    memset(buffer + index, 0, frameSize - index);
+    return frameSize;
+}
+
+void Message::setExtended(bool extended, bool crc) {
+    crc = crc && extended;
+    if (this->m_extended == extended && this->m_crc == crc) {
+        return;
+    }
+    this->m_extended = extended;
+    this->m_crc = crc;
+    this->m_checksum = this->calculateChecksum();
+}
+
+unsigned long Message::getDataAsUl() const {
+    unsigned long value = 0;
+    const C_BYTE *data = this->getDataBytes();
+    for (size_t i = 0; i < this->m_dataSize; i++) {
+        value = value << BYTE | data[i];
     }
+    return value;
+}
 
+vector<C_BYTE> Message::toCharVector() const {
+    vector<C_BYTE> vectorMessage(this->getFrameSize());
+    this->encode(vectorMessage.data(), vectorMessage.size());
     return vectorMessage;
 }
 
 ostream& operator<<(ostream& stream, const Message& message) {
-    stream << "Size: " << message.getSize() << ", Sequence: " << message.m_sequenceId.to_ulong();
+    stream << "Size: " << message.getSize() << ", Sequence: " << message.m_sequenceId;
     stream << ", Type: " << toString(message.m_type);
-    if (!message.getData().empty()) {
+    if (message.m_dataSize > 0) {
         stream << ", Data_str: " << message.getDataAsString();
         stream << ", Data_ul: " << message.getDataAsUl();
     }
-    stream << ", Parity: " << message.m_parity;
+    if (message.m_crc) {
+        stream << ", CRC: " << hex << setw(8) << setfill('0') << message.m_checksum << dec << setfill(' ');
+    }
+    else {
+        stream << ", Parity: " << T_BYTE(message.m_checksum);
+    }
     return stream;
 }
 
@@ -147,16 +277,19 @@ Message::operator std::string() const {
 }
 
 bool operator==(const Message &msg1, const Message &msg2) {
-    return msg1.m_sequenceId == msg2.m_sequenceId && msg1.m_type == msg2.m_type && msg1.m_parity == msg2.m_parity &&
-            msg1.m_size == msg2.m_size && msg1.m_data == msg2.m_data;
+    return msg1.m_sequenceId == msg2.m_sequenceId && msg1.m_type == msg2.m_type && msg1.m_checksum == msg2.m_checksum &&
+            msg1.getSize() == msg2.getSize() &&
+            memcmp(msg1.getDataBytes(), msg2.getDataBytes(), msg1.m_dataSize) == 0;
 }
 
 bool operator!=(const Message &msg1, const Message &msg2) {
     return !(msg1 == msg2);
 }
 
-std::vector<Message> Message::fromLongString(MessageType type, int sequence, const string &stringData) {
+std::vector<Message> Message::fromLongString(MessageType type, unsigned long sequence, const string &stringData,
+                                             size_t maxDataSize) {
     std::vector<Message> messages;
+    messages.reserve(max(static_cast<size_t>(1), (stringData.size() + maxDataSize - 1) / maxDataSize));
 
     if (stringData.empty()) {
         messages.emplace_back(type, sequence);
@@ -164,14 +297,9 @@ std::vector<Message> Message::fromLongString(MessageType type, int sequence, con
 
     size_t index = 0;
     while (index < stringData.size()) {
-        if (stringData.size() >= MAX_DATA_SIZE) {
-            string substr = stringData.substr(index, min(stringData.size() - index, static_cast<size_t>(MAX_DATA_SIZE)));
-            messages.emplace_back(type, sequence, vector<C_BYTE>(substr.begin(), substr.end()));
-        }
-        else {
-            messages.emplace_back(type, sequence, vector<C_BYTE>(stringData.begin(), stringData.end()));
-        }
-        index += MAX_DATA_SIZE;
+        size_t chunkSize = min(stringData.size() - index, maxDataSize);
+        messages.emplace_back(type, sequence, reinterpret_cast<const C_BYTE *>(stringData.data()) + index, chunkSize);
+        index += chunkSize;
         sequence++;
     }
 
@@ -2,6 +2,7 @@
 #define REDES_1_T1_MESSAGE_H
 
 #include <bitset>
+#include <cstdint>
 #include <vector>
 #include "../Logger/Logger.h"
 
@@ -13,18 +14,39 @@
 #define MIN_SIZE static_cast<size_t>(4)
 #define MAX_SIZE static_cast<size_t>(63)
 #define MAX_DATA_SIZE (MAX_SIZE - MIN_SIZE)
+/// \brief Messages are padded to this size when sent, to respect the minimum ethernet frame size.
+#define MIN_FRAME_SIZE static_cast<size_t>(64)
 
 #define BEGIN_DELIMITER 0b01111110
 #define MAX_SEQ 0b1111ul
 #define MAX_SEQ_COUNT (MAX_SEQ + 1ul)
 
+/// \brief Extended messages start with the delimiter with these bits flipped.
+#define EXTENDED_DELIMITER_MASK 0b00000011
+/// \brief Extended header: delimiter, type, 32 bit sequence id and 16 bit data size. Followed by data and parity.
+#define EXTENDED_HEADER_SIZE static_cast<size_t>(8)
+#define EXTENDED_MIN_SIZE (EXTENDED_HEADER_SIZE + 1)
+#define EXTENDED_MAX_SEQ 0xFFFFFFFFul
+#define EXTENDED_MAX_SEQ_COUNT (EXTENDED_MAX_SEQ + 1ul)
+/// \brief Limit of the 16 bit data size of the extended header.
+#define EXTENDED_MAX_DATA_SIZE static_cast<size_t>(0xFFFF)
+#define EXTENDED_MAX_FRAME_SIZE (EXTENDED_MIN_SIZE + EXTENDED_MAX_DATA_SIZE)
+/// \brief Set in the type byte of extended messages that end with a CRC-32C (4 bytes, big endian) instead of the
+/// parity byte.
+#define EXTENDED_CRC_FLAG 0b10000000
+#define CRC_TRAILER_SIZE static_cast<size_t>(4)
+/// \brief Frame size used until the nodes agree on a larger one: an extended message with as much data as a normal one.
+#define DEFAULT_FRAME_SIZE (EXTENDED_MIN_SIZE + MAX_DATA_SIZE)
+
 using namespace std;
 
 /// \brief The bits represeting each message type. Those bits were chosen by the class...
-enum class MessageType {
+enum class MessageType : C_BYTE {
     OK = 0b000001,
     ACK = 0b000011,
     NACK = 0b000010,
+    SACK = 0b000100,
+    NEGOTIATE = 0b000101,
     ERROR = 0b010001,
     CD = 0b000110,
     LS = 0b000111,
@@ -34,6 +56,14 @@ enum class MessageType {
     FILE_DESCRIPTOR = 0b011000,
     FILE_DATA = 0b100000,
     PUT = 0b001010,
+    /// \brief Expand file name patterns on the other node, answered with a LS_SHOW listing the matching files.
+    GLOB = 0b001011,
+    /// \brief Block signatures of the copy of a file the receiver already has, asking for a delta instead of the data.
+    SIGNATURE = 0b001100,
+    /// \brief Instructions rebuilding a file from the copy of the receiver, see DeltaEncoder.
+    DELTA = 0b001101,
+    /// \brief Hashes and sizes of the chunks of a file, or the bitmap of the ones the receiver is missing.
+    CHUNKS = 0b001110,
     END = 0b101110,
     INVALID
 };
@@ -42,57 +72,77 @@ string toString(MessageType messageType);
 
 /**
  * @brief Represents a Message to be sent.
+ *
+ * Data that fits in a normal message is stored inline, only the larger payloads of extended messages use the heap, so
+ * control messages and default sized frames are created, copied and encoded without allocating.
  */
 class Message {
 public:
-    explicit Message(MessageType type, int sequenceId, vector<C_BYTE> &&data) :
-            m_type(type), m_sequenceId(sequenceId), m_data(data)
-    {
-        if (m_data.size() > MAX_DATA_SIZE) {
-            logger->error("Trying to create a message with size: " +
-                            to_string(m_data.size()) + " content will be truncated.");
-            m_data.erase(m_data.begin()+64, m_data.end());
-        }
-        this->m_size = MIN_SIZE + m_data.size();
-        this->calculateParity();
-    };
-
-    explicit Message(MessageType type, int sequenceId, unsigned long data) :
-            m_type(type), m_sequenceId(sequenceId) {
-        this->m_data.push_back(static_cast<C_BYTE>(data));
-        this->m_size = MIN_SIZE + m_data.size();
-        this->calculateParity();
-    }
+    /// \brief Empty INVALID message, for containers whose slots are filled later.
+    Message() = default;
+    explicit Message(MessageType type, unsigned long sequenceId, vector<C_BYTE> &&data);
+    explicit Message(MessageType type, unsigned long sequenceId, const C_BYTE *data, size_t size);
 
-    explicit Message(MessageType type, int sequenceId) : m_type(type), m_sequenceId(sequenceId) {
-        this->m_size = MIN_SIZE;
-        this->calculateParity();
+    /// \brief Create a message whose data is a number, stored big endian in as few bytes as possible.
+    explicit Message(MessageType type, unsigned long sequenceId, unsigned long data);
+
+    explicit Message(MessageType type, unsigned long sequenceId) :
+            m_sequenceId(static_cast<uint32_t>(sequenceId)), m_type(type) {
+        this->m_checksum = this->calculateChecksum();
     }
 
-    explicit Message(const C_BYTE* bytesMessage);
+    /// \brief Decode a message received from the network, in either the normal or the extended format.
+    explicit Message(const C_BYTE* bytesMessage, size_t size);
 
     /**
      * @brief Construct messages as needed from a string containing the data to be sent.
      * @param type The type of the messages.
      * @param sequence The start sequence of the message.
      * @param stringData The string containing the data to be broken into multiple messages
+     * @param maxDataSize How much data fits in each message, depends on the header and frame size in use.
      * @return A vector containing all the messages needed to send the data.
      */
-    static std::vector<Message> fromLongString(MessageType type, int sequence, const string& stringData);
+    static std::vector<Message> fromLongString(MessageType type, unsigned long sequence, const string& stringData,
+                                               size_t maxDataSize = MAX_DATA_SIZE);
 
+    /// \brief Write the frame of this message to buffer, padded to MIN_FRAME_SIZE.
+    /// \return The size of the frame, or 0 if it doesn't fit in capacity bytes.
+    size_t encode(C_BYTE *buffer, size_t capacity) const;
     /// \brief Transforms this message into a vector of bytes.
-    vector<C_BYTE> toCharVector();
-
-    size_t getSize() const { return this->m_size.to_ullong(); }
-    size_t getSequenceId() const { return this->m_sequenceId.to_ullong(); }
+    vector<C_BYTE> toCharVector() const;
+
+    /// \brief Choose between the normal header (4 bit sequence id) and the extended one (32 bit sequence id and
+    /// 16 bit size). Messages with more than MAX_DATA_SIZE bytes of data can only be sent with the extended header.
+    /// \param crc end the message with a CRC-32C instead of the parity byte, only possible with the extended header.
+    void setExtended(bool extended, bool crc = false);
+    bool isExtended() const { return this->m_extended; }
+    bool hasCrc() const { return this->m_crc; }
+
+    size_t getSize() const {
+        if (!this->m_extended) {
+            return MIN_SIZE + this->m_dataSize;
+        }
+        return EXTENDED_HEADER_SIZE + this->m_dataSize + (this->m_crc ? CRC_TRAILER_SIZE : 1);
+    }
+    /// \brief Size of the encoded frame, including the padding.
+    size_t getFrameSize() const { return max(this->getSize(), MIN_FRAME_SIZE); }
+    /// \brief The sequence id, only the bits that fit in the header are sent.
+    size_t getSequenceId() const { return this->m_sequenceId; }
 
     MessageType getType() const { return this->m_type; }
 
-    vector<C_BYTE> getData() const { return this->m_data; }
-    string getDataAsString() const { return string(this->m_data.begin(), this->m_data.end()); }
-    unsigned long getDataAsUl() const { return (this->m_data.empty()) ? 0 : static_cast<unsigned long>(this->m_data[0]); }
+    const C_BYTE *getDataBytes() const {
+        return this->m_dataSize > MAX_DATA_SIZE ? this->m_largeData.data() : this->m_inlineData;
+    }
+    size_t getDataSize() const { return this->m_dataSize; }
+    vector<C_BYTE> getData() const {
+        return vector<C_BYTE>(this->getDataBytes(), this->getDataBytes() + this->m_dataSize);
+    }
+    string getDataAsString() const { return string(this->getDataBytes(), this->getDataBytes() + this->m_dataSize); }
+    /// \brief The data as a big endian number.
+    unsigned long getDataAsUl() const;
 
-    bitset<6> getTypeAsBitset() { return static_cast<int>(this->m_type); }
+    bitset<6> getTypeAsBitset() const { return static_cast<int>(this->m_type); }
 
     operator std::string() const;
 
@@ -104,18 +154,24 @@ public:
     friend bool operator!= (const Message& msg1, const Message& msg2);
 
 private:
-    T_BYTE m_delimiter = BEGIN_DELIMITER;
-    bitset<6> m_size;
-    bitset<4> m_sequenceId = 0b0;
-    MessageType m_type;
-    vector<C_BYTE> m_data;
-    T_BYTE m_parity = 0b0;
-
-    /// \brief calculates the parity of this message for error checking.
-    T_BYTE calculateParity();
-    vector<T_BYTE> toByteVector();
-
-    Logger *logger = Logger::getInstance();
+    uint32_t m_sequenceId = 0;
+    uint16_t m_dataSize = 0;
+    MessageType m_type = MessageType::INVALID;
+    /// \brief The parity byte, or the CRC-32C if m_crc is set.
+    uint32_t m_checksum = 0;
+    bool m_extended = false;
+    bool m_crc = false;
+    C_BYTE m_inlineData[MAX_DATA_SIZE];
+    /// \brief Only used when the data doesn't fit in m_inlineData.
+    vector<C_BYTE> m_largeData;
+
+    /// \brief Copy the data, truncating it to the maximum size of an extended message.
+    void setData(const C_BYTE *data, size_t size);
+    /// \brief Write the delimiter and the header to buffer, which must hold at least EXTENDED_HEADER_SIZE bytes.
+    /// \return The number of bytes written.
+    size_t encodeHeader(C_BYTE *buffer) const;
+    /// \brief calculates the parity (or CRC) of this message for error checking.
+    uint32_t calculateChecksum() const;
 };
 
 
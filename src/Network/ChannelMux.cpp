@@ -0,0 +1,62 @@
+#include "ChannelMux.h"
+
+MuxChannel::MuxChannel(ChannelMux &mux, C_BYTE id, bool accepted) :
+        MuxEndpoint(mux, id, PeerAddress(), accepted, CHANNEL_QUEUE_SIZE) {}
+
+MuxChannel::~MuxChannel() {
+    if (!this->m_accepted) {
+        this->sendClose();
+    }
+}
+
+void MuxChannel::throwClosed() const {
+    throw ChannelClosed("Channel " + to_string(this->m_id) + " closed.");
+}
+
+void MuxChannel::sendClose() {
+    this->m_sendBatch.clear();
+    *this->appendFrame(1) = CHANNEL_CLOSE;
+    this->sendFrames();
+}
+
+ChannelMux::ChannelMux(unique_ptr<Transport> transport) :
+        Multiplexer(move(transport), CHANNEL_DELIMITER, CHANNEL_ID_SIZE, MAX_CHANNELS, CHANNEL_IDLE_TIMEOUT) {
+    this->start();
+}
+
+ChannelMux::~ChannelMux() {
+    this->stop();
+}
+
+unique_ptr<Transport> ChannelMux::open(C_BYTE id) {
+    unique_ptr<MuxEndpoint> channel = Multiplexer::open(id);
+    if (channel) {
+        // The other node may still serve a channel with this id for a node we replaced (e.g. a client that was
+        // restarted), possibly in the middle of a sequence it would keep sending. Ends it before our first frame.
+        static_cast<MuxChannel *>(channel.get())->sendClose();
+    }
+    return channel;
+}
+
+void ChannelMux::accept(ChannelAcceptor acceptor) {
+    if (!acceptor) {
+        Multiplexer::accept(nullptr);
+        return;
+    }
+    Multiplexer::accept([acceptor](unique_ptr<Transport> channel, uint32_t) {
+        acceptor(move(channel));
+    });
+}
+
+MuxEndpoint *ChannelMux::newEndpoint(uint32_t id, const PeerAddress &, bool accepted) {
+    return new MuxChannel(*this, static_cast<C_BYTE>(id), accepted);
+}
+
+bool ChannelMux::admit(MuxEndpoint *endpoint, const C_BYTE *frame, size_t, const PeerAddress &) {
+    if (frame[0] == CHANNEL_CLOSE) {
+        // Channels we opened are only closed by us.
+        this->closeAccepted(endpoint);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef REDES_1_T1_CHANNELMUX_H
+#define REDES_1_T1_CHANNELMUX_H
+
+#include <stdexcept>
+#include "Multiplexer.h"
+
+/// \brief Bytes of the channel id, sent after CHANNEL_DELIMITER in front of each frame of a multiplexed link.
+#define CHANNEL_ID_SIZE 1
+/// \brief Starts every frame of a multiplexed link. Differs from the message delimiters (normal, extended and
+/// inverted), so frames of a node that isn't multiplexed are dropped instead of being routed to a channel.
+#define CHANNEL_DELIMITER 0b01101001
+/// \brief Channel ids are a single byte.
+#define MAX_CHANNELS 256
+/// \brief Frames held by the queue of each channel, enough for the largest window of the extended header.
+#define CHANNEL_QUEUE_SIZE 4096
+/// \brief Sent after the channel header by a channel that is opened or closed, so the other node stops serving the
+/// channel it has with that id. Differs from the message delimiters, which start the other frames after the header.
+#define CHANNEL_CLOSE 0
+/// \brief A channel opened by the other node that receives nothing for this long (in seconds) is closed, in case its
+/// close was lost or the other node stopped without closing it.
+#define CHANNEL_IDLE_TIMEOUT 3600
+
+class ChannelMux;
+
+/// \brief Thrown by the receive methods of an accepted channel once it was closed by the other node (or expired) and
+/// its frames were all received, stopping the node that serves it.
+class ChannelClosed: public runtime_error {
+    using runtime_error::runtime_error;
+};
+
+/**
+ * @brief One of the channels of a multiplexed link. To the node using it, it is a transport of its own: its frames
+ * only reach the channel with the same id on the other node, so each channel has its own sliding window, sequence
+ * ids and timers, and a transfer on one channel doesn't hold back the commands of another.
+ *
+ * Its receive methods throw ChannelClosed once it was closed.
+ */
+class MuxChannel: public MuxEndpoint {
+public:
+    /// \brief Close the channel, frames received for it from now on are dropped (or accepted as a new channel). A
+    /// channel we opened tells the other node, so the node serving it there stops.
+    ~MuxChannel() override;
+
+    C_BYTE id() const { return static_cast<C_BYTE>(m_id); }
+
+private:
+    friend class ChannelMux;
+    MuxChannel(ChannelMux& mux, C_BYTE id, bool accepted);
+
+    void throwClosed() const override;
+    /// \brief Tell the other node to stop serving the channel with our id, see CHANNEL_CLOSE.
+    void sendClose();
+};
+
+/**
+ * @brief Shares a single link between several channels, each used by a node of its own (usually in a thread of its
+ * own), so several commands and transfers can be in flight at once.
+ *
+ * Every frame starts with CHANNEL_DELIMITER and the id of its channel. Both nodes must multiplex the link.
+ *
+ * A channel opened with open() sends a frame with CHANNEL_CLOSE when it is opened and when it is closed, and the
+ * channel accepted for its id on the other node ends (see ChannelClosed) once its frames were received. A worker of a
+ * client that is restarted gets a new node instead of reaching the one that served the previous client, which may
+ * still be in the middle of a sequence.
+ */
+class ChannelMux: public Multiplexer {
+public:
+    /// \brief Called by the receiving thread of the mux with a channel opened by the other node. Must return quickly,
+    /// frames of every channel wait for it.
+    typedef function<void(unique_ptr<Transport> channel)> ChannelAcceptor;
+
+    /// \param transport The link shared by the channels, only used by the mux from now on.
+    explicit ChannelMux(unique_ptr<Transport> transport);
+    /// \brief Stop the receiving thread. Every channel must be closed before.
+    ~ChannelMux() override;
+
+    /// \brief Open the channel with the given id.
+    /// \return nullptr if the channel is already open.
+    unique_ptr<Transport> open(C_BYTE id);
+    /// \brief Open a channel for each id that receives a frame while no channel uses it, and hand it to acceptor
+    /// with that frame already queued. Without an acceptor those frames are dropped.
+    void accept(ChannelAcceptor acceptor);
+
+protected:
+    MuxEndpoint *newEndpoint(uint32_t id, const PeerAddress& peer, bool accepted) override;
+    /// \brief Channels don't check the peer, a frame with CHANNEL_CLOSE closes the channel accepted for its id.
+    bool admit(MuxEndpoint *endpoint, const C_BYTE *frame, size_t size, const PeerAddress& peer) override;
+};
+
+
+#endif //REDES_1_T1_CHANNELMUX_H
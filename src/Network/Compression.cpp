@@ -0,0 +1,146 @@
+#include <cstring>
+#include <stdexcept>
+#include "Compression.h"
+
+StreamCompressor::StreamCompressor(Reader reader, int level) :
+        m_reader(move(reader)), m_stream(), m_block(COMPRESSION_BLOCK_SIZE), m_output(2 * COMPRESSION_BLOCK_SIZE),
+        m_level(level), m_currentLevel(level) {
+    if (deflateInit(&this->m_stream, level) != Z_OK) {
+        throw runtime_error("Could not start the compression of a stream.");
+    }
+}
+
+StreamCompressor::~StreamCompressor() {
+    deflateEnd(&this->m_stream);
+}
+
+void StreamCompressor::nextBlock() {
+    int level = this->m_currentLevel;
+    if (this->m_currentLevel != Z_NO_COMPRESSION) {
+        // Approximate, deflate holds back some of the output of a block until the next one.
+        size_t compressed = this->m_stream.total_out - this->m_blockStart;
+        if (this->m_blockSize > 0 && compressed > this->m_blockSize * COMPRESSION_MAX_RATIO) {
+            level = Z_NO_COMPRESSION;
+            this->m_storedBlocks = 0;
+        }
+    }
+    else if (++this->m_storedBlocks >= COMPRESSION_SKIP_BLOCKS) {
+        level = this->m_level;
+    }
+    // The output is empty here, so this only fails if the previous block doesn't fit in it, in which case the switch is
+    // tried again on the next block.
+    if (level != this->m_currentLevel && deflateParams(&this->m_stream, level, Z_DEFAULT_STRATEGY) == Z_OK) {
+        this->m_currentLevel = level;
+    }
+
+    this->m_blockSize = this->m_reader(this->m_block.data(), this->m_block.size());
+    this->m_blockStart = this->m_stream.total_out;
+    this->m_readerDone = this->m_blockSize == 0;
+    this->m_stream.next_in = reinterpret_cast<Bytef *>(this->m_block.data());
+    this->m_stream.avail_in = static_cast<uInt>(this->m_blockSize);
+}
+
+size_t StreamCompressor::read(char *buffer, size_t size) {
+    size_t copied = 0;
+    while (copied < size) {
+        if (this->m_outputStart < this->m_outputEnd) {
+            size_t count = min(size - copied, this->m_outputEnd - this->m_outputStart);
+            memcpy(buffer + copied, this->m_output.data() + this->m_outputStart, count);
+            this->m_outputStart += count;
+            copied += count;
+            continue;
+        }
+        if (this->m_finished) {
+            break;
+        }
+
+        this->m_stream.next_out = reinterpret_cast<Bytef *>(this->m_output.data());
+        this->m_stream.avail_out = static_cast<uInt>(this->m_output.size());
+        if (this->m_stream.avail_in == 0 && !this->m_readerDone) {
+            this->nextBlock();
+        }
+        int status = deflate(&this->m_stream, this->m_readerDone ? Z_FINISH : Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            this->m_finished = true;
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR) {
+            throw runtime_error("Could not compress a stream.");
+        }
+        this->m_outputStart = 0;
+        this->m_outputEnd = this->m_output.size() - this->m_stream.avail_out;
+    }
+    return copied;
+}
+
+string StreamCompressor::compress(const string &data) {
+    size_t offset = 0;
+    StreamCompressor compressor([&data, &offset](char *buffer, size_t size) {
+        size_t count = data.copy(buffer, size, offset);
+        offset += count;
+        return count;
+    });
+
+    string result;
+    char buffer[4096];
+    size_t read;
+    while ((read = compressor.read(buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, read);
+    }
+    return result;
+}
+
+StreamDecompressor::StreamDecompressor(Writer writer) :
+        m_writer(move(writer)), m_stream(), m_output(COMPRESSION_BLOCK_SIZE) {
+    if (inflateInit(&this->m_stream) != Z_OK) {
+        throw runtime_error("Could not start the decompression of a stream.");
+    }
+}
+
+StreamDecompressor::~StreamDecompressor() {
+    inflateEnd(&this->m_stream);
+}
+
+bool StreamDecompressor::write(const C_BYTE *data, size_t size) {
+    this->m_stream.next_in = const_cast<Bytef *>(data);
+    this->m_stream.avail_in = static_cast<uInt>(size);
+    // Keeps going while there is input left, or while the output fills up, since inflate may still hold some of it.
+    bool more = true;
+    while (more) {
+        if (this->m_finished) {
+            // Nothing may follow the end of the stream.
+            return this->m_stream.avail_in == 0;
+        }
+
+        this->m_stream.next_out = this->m_output.data();
+        this->m_stream.avail_out = static_cast<uInt>(this->m_output.size());
+        int status = inflate(&this->m_stream, Z_NO_FLUSH);
+        if (status == Z_STREAM_END) {
+            this->m_finished = true;
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR) {
+            return false;
+        }
+
+        size_t produced = this->m_output.size() - this->m_stream.avail_out;
+        if (produced > 0 && !this->m_writer(this->m_output.data(), produced)) {
+            return false;
+        }
+        more = this->m_stream.avail_in > 0 || this->m_stream.avail_out == 0;
+    }
+    return true;
+}
+
+string StreamDecompressor::decompress(const string &data, size_t maxSize) {
+    string result;
+    StreamDecompressor decompressor([&result, maxSize](const C_BYTE *chunk, size_t size) {
+        if (size > maxSize - result.size()) {
+            return false;
+        }
+        result.append(reinterpret_cast<const char *>(chunk), size);
+        return true;
+    });
+    if (!decompressor.write(reinterpret_cast<const C_BYTE *>(data.data()), data.size()) || !decompressor.m_finished) {
+        throw runtime_error("Received corrupted compressed data, or more than " + to_string(maxSize) + " bytes of it.");
+    }
+    return result;
+}
@@ -0,0 +1,102 @@
+#ifndef REDES_1_T1_COMPRESSION_H
+#define REDES_1_T1_COMPRESSION_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "../Message/Message.h"
+
+using namespace std;
+
+/// \brief Fastest deflate level, the link is slow but the nodes must keep a window in flight.
+#define COMPRESSION_LEVEL Z_BEST_SPEED
+/// \brief Data read from the stream at once, also the unit in which the compressor decides if compressing pays off.
+#define COMPRESSION_BLOCK_SIZE static_cast<size_t>(64 * 1024)
+/// \brief A block that doesn't shrink below this fraction of its size is taken as incompressible.
+#define COMPRESSION_MAX_RATIO 0.9
+/// \brief Blocks stored without compressing after an incompressible one, before trying to compress again.
+#define COMPRESSION_SKIP_BLOCKS 16
+/// \brief Largest string StreamDecompressor::decompress inflates. A few KiB of deflate may inflate to gigabytes, so a
+/// larger one is taken as corrupted instead of filling the memory.
+#define DECOMPRESSION_MAX_SIZE static_cast<size_t>(64 * 1024 * 1024)
+
+/**
+ * @brief Deflates a stream read in blocks from a reader, handing it out in chunks of any size.
+ *
+ * Once a block doesn't compress (e.g. an archive or an image) the next COMPRESSION_SKIP_BLOCKS are only stored, which
+ * costs a copy instead of a search, so incompressible data doesn't slow the sender down.
+ */
+class StreamCompressor {
+public:
+    /// \brief Reads up to size bytes of the data to compress into buffer, 0 once there is no more data.
+    typedef function<size_t(char *buffer, size_t size)> Reader;
+
+    explicit StreamCompressor(Reader reader, int level = COMPRESSION_LEVEL);
+    ~StreamCompressor();
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    /// \brief Fill buffer with the next compressed bytes, only less than size at the end of the stream.
+    /// \return The number of bytes written, 0 once the whole stream was read.
+    size_t read(char *buffer, size_t size);
+
+    /// \brief Compress a whole string at once.
+    static string compress(const string& data);
+
+    size_t bytesIn() const { return m_stream.total_in; }
+    size_t bytesOut() const { return m_stream.total_out; }
+
+private:
+    Reader m_reader;
+    z_stream m_stream;
+    vector<char> m_block;
+    /// \brief Compressed data not handed out yet. Deflating here instead of into the buffers of read leaves room to
+    /// flush a block whenever the level changes.
+    vector<char> m_output;
+    size_t m_outputStart = 0;
+    size_t m_outputEnd = 0;
+    int m_level;
+    int m_currentLevel;
+    bool m_readerDone = false;
+    bool m_finished = false;
+    /// \brief Size of the last block read and the compressed size when it was read, to tell how much it shrank.
+    size_t m_blockSize = 0;
+    size_t m_blockStart = 0;
+    size_t m_storedBlocks = 0;
+
+    /// \brief Read the next block, choosing the level it is compressed with.
+    void nextBlock();
+};
+
+/**
+ * @brief Inflates a stream made by a StreamCompressor as its chunks arrive, passing the data to a writer.
+ */
+class StreamDecompressor {
+public:
+    /// \brief Consumes the inflated data, in order.
+    /// \return false if the data couldn't be stored.
+    typedef function<bool(const C_BYTE *data, size_t size)> Writer;
+
+    explicit StreamDecompressor(Writer writer);
+    ~StreamDecompressor();
+    StreamDecompressor(const StreamDecompressor&) = delete;
+    StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+    /// \brief Inflate the next chunk of the stream.
+    /// \return false if the chunk is corrupted or the writer failed.
+    bool write(const C_BYTE *data, size_t size);
+
+    /// \brief Decompress a whole string made by StreamCompressor::compress.
+    /// \throw runtime_error if the data is corrupted or inflates to more than maxSize bytes.
+    static string decompress(const string& data, size_t maxSize = DECOMPRESSION_MAX_SIZE);
+
+private:
+    Writer m_writer;
+    z_stream m_stream;
+    vector<C_BYTE> m_output;
+    bool m_finished = false;
+};
+
+
+#endif //REDES_1_T1_COMPRESSION_H
@@ -0,0 +1,58 @@
+#ifndef REDES_1_T1_DOORBELL_H
+#define REDES_1_T1_DOORBELL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/// \brief How long a queue is polled before sleeping, waking a thread up costs more than a short spin.
+#define DOORBELL_SPIN_TIME chrono::microseconds(50)
+
+/**
+ * @brief Lets a thread sleep until a lock-free queue changes. Ringing only takes the lock when the other thread is
+ * asleep, so there is no system call while both threads keep up.
+ *
+ * The change must be published with a sequentially consistent store and checked by ready with a sequentially
+ * consistent load, so either the sleeper sees it or the ringer sees the sleeper.
+ */
+class Doorbell {
+public:
+    /// \brief Wait until ready returns true or the deadline passes.
+    /// \return The last value returned by ready.
+    template<typename Ready>
+    bool waitUntil(Ready ready, chrono::steady_clock::time_point deadline) {
+        auto spinEnd = min(deadline, chrono::steady_clock::now() + DOORBELL_SPIN_TIME);
+        do {
+            if (ready()) {
+                return true;
+            }
+            this_thread::yield();
+        } while (chrono::steady_clock::now() < spinEnd);
+
+        unique_lock<mutex> lock(this->m_mutex);
+        this->m_sleeping = true;
+        bool result = this->m_condition.wait_until(lock, deadline, ready);
+        this->m_sleeping = false;
+        return result;
+    }
+    /// \brief Wake the thread sleeping in waitUntil, if any. Must be called after the change is published.
+    void ring() {
+        if (this->m_sleeping) {
+            lock_guard<mutex> lock(this->m_mutex);
+            this->m_condition.notify_all();
+        }
+    }
+
+private:
+    mutex m_mutex;
+    condition_variable m_condition;
+    atomic<bool> m_sleeping{false};
+};
+
+
+#endif //REDES_1_T1_DOORBELL_H
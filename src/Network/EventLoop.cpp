@@ -0,0 +1,94 @@
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "EventLoop.h"
+
+EventLoop::EventLoop() {
+    this->m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (this->m_epoll == -1) {
+        throw runtime_error("Could not create the epoll instance: " + string(strerror(errno)));
+    }
+    // steady_clock is CLOCK_MONOTONIC on Linux, so deadlines are given to the timer as they are.
+    this->m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (this->m_timer == -1) {
+        close(this->m_epoll);
+        throw runtime_error("Could not create the timer: " + string(strerror(errno)));
+    }
+    this->watch(this->m_timer);
+}
+
+EventLoop::~EventLoop() {
+    close(this->m_timer);
+    close(this->m_epoll);
+}
+
+void EventLoop::watch(int fd) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(this->m_epoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+        throw runtime_error("Could not watch the file descriptor: " + string(strerror(errno)));
+    }
+}
+
+void EventLoop::armTimer(chrono::steady_clock::time_point deadline) {
+    // A zero it_value disarms the timer.
+    struct itimerspec value;
+    memset(&value, 0, sizeof(value));
+    if (deadline != chrono::steady_clock::time_point::max()) {
+        auto nanoseconds = chrono::duration_cast<chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        nanoseconds = max(nanoseconds, static_cast<decltype(nanoseconds)>(1));
+        value.it_value.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+        value.it_value.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+    }
+    // Setting the timer also clears an expiration that wasn't read yet.
+    timerfd_settime(this->m_timer, TFD_TIMER_ABSTIME, &value, nullptr);
+    this->m_timerDeadline = deadline;
+}
+
+bool EventLoop::waitReadable(chrono::steady_clock::time_point deadline) {
+    // A timer armed for an earlier deadline is left alone: waking up early once costs less than moving the timer
+    // every time the deadline moves forward (e.g. at each window).
+    if (deadline < this->m_timerDeadline) {
+        this->armTimer(deadline);
+    }
+
+    struct epoll_event events[2];
+    while (true) {
+        int count = epoll_wait(this->m_epoll, events, 2, -1);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        bool expired = false;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd != this->m_timer) {
+                // Data wins over the timer, the caller checks its own deadlines once it is handled.
+                return true;
+            }
+            expired = true;
+        }
+        if (expired) {
+            uint64_t expirations;
+            if (read(this->m_timer, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+                return false;
+            }
+            // A one shot timer is disarmed once it expires.
+            this->m_timerDeadline = chrono::steady_clock::time_point::max();
+            if (chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            this->armTimer(deadline);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef REDES_1_T1_EVENTLOOP_H
+#define REDES_1_T1_EVENTLOOP_H
+
+#include <chrono>
+
+using namespace std;
+
+/**
+ * @brief Sleeps until a watched file descriptor is readable or a deadline passes, with a single epoll_wait on the
+ * descriptors and a timerfd armed at the deadline.
+ *
+ * The thread doesn't wake up at all while nothing happens, and a deadline wakes it up when it passes instead of at
+ * the end of a fixed receive timeout.
+ */
+class EventLoop {
+public:
+    /// \brief Create the epoll instance and the timer, throws runtime_error if the kernel refuses either.
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /// \brief Wake waitReadable up when fd becomes readable.
+    void watch(int fd);
+    /**
+     * @brief Sleep until a watched descriptor is readable or the deadline passes.
+     * @param deadline time_point::max() to wait without a timer.
+     * @return true if a watched descriptor is readable, false if the deadline passed first.
+     */
+    bool waitReadable(chrono::steady_clock::time_point deadline);
+
+private:
+    int m_epoll = -1;
+    int m_timer = -1;
+    /// \brief Deadline the timer is armed at, time_point::max() if it is disarmed.
+    chrono::steady_clock::time_point m_timerDeadline = chrono::steady_clock::time_point::max();
+
+    void armTimer(chrono::steady_clock::time_point deadline);
+};
+
+
+#endif //REDES_1_T1_EVENTLOOP_H
@@ -0,0 +1,51 @@
+#include <cstring>
+#include "FrameQueue.h"
+
+bool FrameQueue::push(const C_BYTE *frame, size_t size) {
+    vector<C_BYTE> *slot = this->m_frames.back();
+    if (slot == nullptr) {
+        return false;
+    }
+    // Keeps the capacity of the slot, so it only allocates the first times a slot holds a larger frame.
+    slot->assign(frame, frame + size);
+    this->m_frames.push();
+    return true;
+}
+
+bool FrameQueue::wait(long timeout) {
+    auto ready = [this] { return !this->m_frames.empty(); };
+    if (timeout > 0) {
+        return this->m_bell.waitUntil(ready, chrono::steady_clock::now() + chrono::milliseconds(timeout));
+    }
+
+    // Like SO_RCVTIMEO, no timeout waits until a frame arrives.
+    while (!this->m_bell.waitUntil(ready, chrono::steady_clock::now() +
+                                          chrono::milliseconds(FRAME_QUEUE_POLL_INTERVAL))) {}
+    return true;
+}
+
+size_t FrameQueue::receiveBatch(const FrameHandler &handler, size_t maxFrames, long timeout) {
+    if (maxFrames == 0 || !this->wait(timeout)) {
+        return 0;
+    }
+
+    size_t handled = 0;
+    const vector<C_BYTE> *frame;
+    while (handled < maxFrames && (frame = this->m_frames.front()) != nullptr) {
+        handler(frame->data(), frame->size());
+        this->m_frames.pop();
+        handled++;
+    }
+    return handled;
+}
+
+long FrameQueue::receiveFrame(C_BYTE *buffer, size_t size, long timeout) {
+    if (!this->wait(timeout)) {
+        return -1;
+    }
+    const vector<C_BYTE> *frame = this->m_frames.front();
+    size_t count = min(size, frame->size());
+    memcpy(buffer, frame->data(), count);
+    this->m_frames.pop();
+    return static_cast<long>(count);
+}
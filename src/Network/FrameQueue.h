@@ -0,0 +1,42 @@
+#ifndef REDES_1_T1_FRAMEQUEUE_H
+#define REDES_1_T1_FRAMEQUEUE_H
+
+#include "Doorbell.h"
+#include "SpscQueue.h"
+#include "Transport.h"
+
+/// \brief How long a wait without a timeout sleeps before checking the queue again, in milliseconds.
+#define FRAME_QUEUE_POLL_INTERVAL 20
+
+/**
+ * @brief Frames received by a thread that reads the link, waiting for the node that handles them.
+ *
+ * One producer (the reading thread) and one consumer (the node), the consumer side has the same behaviour as the
+ * receive methods of a Transport, so a transport fed by another thread is implemented with a single member.
+ */
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity) : m_frames(capacity) {}
+
+    /// \brief Producer: copy a frame to the queue, without waking the consumer.
+    /// \return false if the queue is full, in which case the frame is dropped.
+    bool push(const C_BYTE *frame, size_t size);
+    /// \brief Producer: wake the consumer up after one or more frames were pushed.
+    void notify() { this->m_bell.ring(); }
+
+    /// \brief Consumer: see Transport::receiveBatch.
+    /// \param timeout how long to wait for the first frame in milliseconds, forever if not positive.
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames, long timeout);
+    /// \brief Consumer: see Transport::receiveFrame.
+    long receiveFrame(C_BYTE *buffer, size_t size, long timeout);
+
+private:
+    SpscQueue<vector<C_BYTE>> m_frames;
+    Doorbell m_bell;
+
+    /// \return false on timeout.
+    bool wait(long timeout);
+};
+
+
+#endif //REDES_1_T1_FRAMEQUEUE_H
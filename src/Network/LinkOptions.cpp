@@ -0,0 +1,62 @@
+#include <algorithm>
+#include "LinkOptions.h"
+
+#define FLAG_EXTENDED_HEADER 0b00000001
+#define FLAG_SELECTIVE_REPEAT 0b00000010
+#define FLAG_CRC32C 0b00000100
+#define FLAG_COMPRESSION 0b00001000
+
+LinkOptions LinkOptions::negotiated() const {
+    LinkOptions options = *this;
+    options.maxFrameSize = min(max(options.maxFrameSize, DEFAULT_FRAME_SIZE), EXTENDED_MAX_FRAME_SIZE);
+    if (options.maxFrameSize > DEFAULT_FRAME_SIZE || options.crc) {
+        options.extendedHeader = true;
+    }
+    unsigned long maxWindow = options.extendedHeader ? MAX_WINDOW_SIZE : MAX_SEQ_COUNT / 2;
+    options.windowSize = min(max(options.windowSize, 1ul), maxWindow);
+    return options;
+}
+
+vector<C_BYTE> LinkOptions::toBytes() const {
+    vector<C_BYTE> bytes;
+    C_BYTE flags = 0;
+    if (this->extendedHeader) {
+        flags |= FLAG_EXTENDED_HEADER;
+    }
+    if (this->arqMode == ArqMode::SELECTIVE_REPEAT) {
+        flags |= FLAG_SELECTIVE_REPEAT;
+    }
+    if (this->crc) {
+        flags |= FLAG_CRC32C;
+    }
+    if (this->compression) {
+        flags |= FLAG_COMPRESSION;
+    }
+    bytes.push_back(flags);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        bytes.push_back(static_cast<C_BYTE>(this->windowSize >> shift));
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        bytes.push_back(static_cast<C_BYTE>(this->maxFrameSize >> shift));
+    }
+    return bytes;
+}
+
+LinkOptions LinkOptions::fromBytes(const vector<C_BYTE> &bytes) {
+    LinkOptions options;
+    if (!bytes.empty()) {
+        options.extendedHeader = (bytes[0] & FLAG_EXTENDED_HEADER) != 0;
+        options.arqMode = (bytes[0] & FLAG_SELECTIVE_REPEAT) != 0 ? ArqMode::SELECTIVE_REPEAT : ArqMode::GO_BACK_N;
+        options.crc = (bytes[0] & FLAG_CRC32C) != 0;
+        options.compression = (bytes[0] & FLAG_COMPRESSION) != 0;
+    }
+    if (bytes.size() >= 5) {
+        options.windowSize = static_cast<unsigned long>(bytes[1]) << 24 | static_cast<unsigned long>(bytes[2]) << 16 |
+                             static_cast<unsigned long>(bytes[3]) << 8 | bytes[4];
+    }
+    if (bytes.size() >= 9) {
+        options.maxFrameSize = static_cast<size_t>(bytes[5]) << 24 | static_cast<size_t>(bytes[6]) << 16 |
+                               static_cast<size_t>(bytes[7]) << 8 | bytes[8];
+    }
+    return options;
+}
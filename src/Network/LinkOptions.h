@@ -0,0 +1,60 @@
+#ifndef REDES_1_T1_LINKOPTIONS_H
+#define REDES_1_T1_LINKOPTIONS_H
+
+#include <vector>
+#include "../Message/Message.h"
+
+using namespace std;
+
+/// \brief Window used until the nodes agree on another one.
+#define WINDOW_SIZE 4
+/// \brief Largest window accepted with the extended header.
+#define MAX_WINDOW_SIZE 4096
+
+/// \brief How the sliding window recovers from lost or corrupted messages.
+enum class ArqMode {
+    /// \brief The receiver only accepts messages in order, the sender resends everything after the first loss.
+    GO_BACK_N,
+    /// \brief The receiver buffers out of order messages and acknowledges them with a bitmap (SACK), the sender only
+    /// resends the missing ones.
+    SELECTIVE_REPEAT
+};
+
+/**
+ * @brief Protocol settings agreed by both nodes with a NEGOTIATE message when the client starts.
+ *
+ * Until then both nodes use the defaults, which every node understands: go-back-N, the normal header, a window
+ * of WINDOW_SIZE messages and frames of at most DEFAULT_FRAME_SIZE bytes.
+ */
+struct LinkOptions {
+    ArqMode arqMode = ArqMode::GO_BACK_N;
+    /// \brief Send the extended header, with 32 bit sequence ids, needed by windows larger than half of MAX_SEQ_COUNT.
+    bool extendedHeader = false;
+    /// \brief End the messages with a CRC-32C instead of the parity byte, only possible with the extended header.
+    bool crc = false;
+    /// \brief Deflate the data of files and listings (FILE_DATA and LS_SHOW sequences) before splitting it in messages.
+    bool compression = false;
+    unsigned long windowSize = WINDOW_SIZE;
+    /// \brief Largest frame sent, frames larger than DEFAULT_FRAME_SIZE need the extended header.
+    size_t maxFrameSize = DEFAULT_FRAME_SIZE;
+
+    /// \brief Number of distinct sequence ids that can be sent in the header.
+    unsigned long sequenceSpace() const { return extendedHeader ? EXTENDED_MAX_SEQ_COUNT : MAX_SEQ_COUNT; }
+    /// \brief How much data fits in a single message.
+    size_t maxDataSize() const {
+        return extendedHeader ? maxFrameSize - EXTENDED_HEADER_SIZE - (crc ? CRC_TRAILER_SIZE : 1) : MAX_DATA_SIZE;
+    }
+    /// \brief Copy of these options with the window reduced to what the sequence space allows and the frame size to
+    /// what the header can describe. The window can't be larger than half the sequence space, otherwise a resent
+    /// message can't be told apart from a new one.
+    LinkOptions negotiated() const;
+
+    /// \brief Encode the options as the data of a NEGOTIATE message: a byte of flags, then the window and the frame
+    /// size (32 bits each).
+    vector<C_BYTE> toBytes() const;
+    /// \brief Decode the data of a NEGOTIATE message, missing fields keep their default value.
+    static LinkOptions fromBytes(const vector<C_BYTE>& bytes);
+};
+
+
+#endif //REDES_1_T1_LINKOPTIONS_H
@@ -0,0 +1,30 @@
+#include "LossyTransport.h"
+
+bool LossyTransport::drop() {
+    if (uniform_real_distribution<double>(0.0, 1.0)(this->m_random) < this->m_lossRate) {
+        this->m_dropped++;
+        return true;
+    }
+    return false;
+}
+
+long LossyTransport::sendFrame(const C_BYTE *frame, size_t size) {
+    if (this->drop()) {
+        // The frame is lost on the "cable", as far as the sender knows it was sent.
+        return static_cast<long>(size);
+    }
+    return this->m_transport->sendFrame(frame, size);
+}
+
+size_t LossyTransport::sendBatch(const FrameBatch &batch) {
+    this->m_survivors.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (!this->drop()) {
+            this->m_survivors.add(batch.frame(i), batch.frameSize(i));
+        }
+    }
+    if (!this->m_survivors.empty()) {
+        this->m_transport->sendBatch(this->m_survivors);
+    }
+    return batch.size();
+}
@@ -0,0 +1,50 @@
+#ifndef REDES_1_T1_LOSSYTRANSPORT_H
+#define REDES_1_T1_LOSSYTRANSPORT_H
+
+#include <random>
+#include "Transport.h"
+
+/**
+ * @brief Wraps another transport, silently dropping a fraction of the frames sent through it.
+ *
+ * Used to measure and test how the protocol behaves on a lossy link without touching a real cable.
+ */
+class LossyTransport: public Transport {
+public:
+    /// \param transport The transport that actually moves the frames.
+    /// \param lossRate Probability, between 0 and 1, of each sent frame being dropped.
+    /// \param seed Seed of the random generator, so a run can be reproduced.
+    LossyTransport(unique_ptr<Transport> transport, double lossRate, unsigned int seed = 0) :
+            m_transport(move(transport)), m_lossRate(lossRate), m_random(seed) {}
+
+    long sendFrame(const C_BYTE *frame, size_t size) override;
+    long receiveFrame(C_BYTE *buffer, size_t size) override { return m_transport->receiveFrame(buffer, size); }
+    void setReceiveTimeout(long milliseconds) override { m_transport->setReceiveTimeout(milliseconds); }
+
+    size_t sendBatch(const FrameBatch& batch) override;
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames) override {
+        return m_transport->receiveBatch(handler, maxFrames);
+    }
+
+    bool echoesOwnFrames() const override { return m_transport->echoesOwnFrames(); }
+    int pollDescriptor() const override { return m_transport->pollDescriptor(); }
+    bool hasPendingFrames() const override { return m_transport->hasPendingFrames(); }
+    size_t maxFrameSize() const override { return m_transport->maxFrameSize(); }
+    void setFrameSize(size_t size) override { m_transport->setFrameSize(size); }
+
+    /// \brief Number of frames dropped so far.
+    size_t droppedFrames() const { return m_dropped; }
+
+private:
+    unique_ptr<Transport> m_transport;
+    double m_lossRate;
+    mt19937 m_random;
+    size_t m_dropped = 0;
+    FrameBatch m_survivors;
+
+    /// \brief Decide if the next frame is lost.
+    bool drop();
+};
+
+
+#endif //REDES_1_T1_LOSSYTRANSPORT_H
@@ -0,0 +1,197 @@
+#include <cstring>
+#include "Multiplexer.h"
+
+MuxEndpoint::~MuxEndpoint() {
+    this->m_mux.close(this);
+}
+
+C_BYTE *MuxEndpoint::appendFrame(size_t size) {
+    C_BYTE *out = this->m_sendBatch.append(this->m_mux.m_headerSize + size);
+    out[0] = this->m_mux.m_delimiter;
+    uint32_t id = this->m_id;
+    for (size_t i = this->m_mux.m_idSize; i > 0; i--) {
+        out[i] = static_cast<C_BYTE>(id);
+        id >>= 8;
+    }
+    return out + this->m_mux.m_headerSize;
+}
+
+size_t MuxEndpoint::sendFrames() {
+    return this->m_mux.send(this->m_sendBatch, this->m_peer);
+}
+
+long MuxEndpoint::sendFrame(const C_BYTE *frame, size_t size) {
+    this->m_sendBatch.clear();
+    memcpy(this->appendFrame(size), frame, size);
+    return this->sendFrames() == 1 ? static_cast<long>(size) : -1;
+}
+
+size_t MuxEndpoint::sendBatch(const FrameBatch &batch) {
+    this->m_sendBatch.clear();
+    for (size_t i = 0; i < batch.size(); i++) {
+        memcpy(this->appendFrame(batch.frameSize(i)), batch.frame(i), batch.frameSize(i));
+    }
+    return this->sendFrames();
+}
+
+long MuxEndpoint::receiveFrame(C_BYTE *buffer, size_t size) {
+    long received = this->m_received.receiveFrame(buffer, size, this->m_receiveTimeout);
+    if (received < 0 && this->m_closed) {
+        this->throwClosed();
+    }
+    return received;
+}
+
+size_t MuxEndpoint::receiveBatch(const FrameHandler &handler, size_t maxFrames) {
+    size_t received = this->m_received.receiveBatch(handler, maxFrames, this->m_receiveTimeout);
+    if (received == 0 && this->m_closed) {
+        this->throwClosed();
+    }
+    return received;
+}
+
+bool MuxEndpoint::echoesOwnFrames() const {
+    return this->m_mux.echoesOwnFrames();
+}
+
+size_t MuxEndpoint::maxFrameSize() const {
+    return this->m_mux.maxFrameSize();
+}
+
+Multiplexer::Multiplexer(unique_ptr<Transport> transport, C_BYTE delimiter, size_t idSize, size_t maxEndpoints,
+                         long idleTimeout) :
+        m_transport(move(transport)), m_delimiter(delimiter), m_idSize(idSize), m_headerSize(1 + idSize),
+        m_maxEndpoints(maxEndpoints), m_idleTimeout(idleTimeout) {
+    // Short waits, so the receiving thread notices when it must stop, for frames of any size, since each endpoint
+    // may use its own.
+    this->m_transport->setReceiveTimeout(MUX_POLL_INTERVAL);
+    this->m_transport->setFrameSize(this->m_transport->maxFrameSize());
+}
+
+Multiplexer::~Multiplexer() {
+    this->stop();
+}
+
+void Multiplexer::start() {
+    this->m_receiver = thread(&Multiplexer::receiveLoop, this);
+}
+
+void Multiplexer::stop() {
+    this->m_stopping = true;
+    if (this->m_receiver.joinable()) {
+        this->m_receiver.join();
+    }
+}
+
+unique_ptr<MuxEndpoint> Multiplexer::open(uint32_t id) {
+    lock_guard<mutex> lock(this->m_endpointsMutex);
+    if (this->m_endpoints.count(id) != 0) {
+        return nullptr;
+    }
+    unique_ptr<MuxEndpoint> endpoint(this->newEndpoint(id, PeerAddress(), false));
+    this->m_endpoints[id] = endpoint.get();
+    return endpoint;
+}
+
+void Multiplexer::accept(Acceptor acceptor) {
+    lock_guard<mutex> lock(this->m_endpointsMutex);
+    this->m_acceptor = move(acceptor);
+}
+
+void Multiplexer::close(MuxEndpoint *endpoint) {
+    lock_guard<mutex> lock(this->m_endpointsMutex);
+    // A closed endpoint was already replaced by a new one with the same id, if the other node opened it again.
+    auto found = this->m_endpoints.find(endpoint->m_id);
+    if (found != this->m_endpoints.end() && found->second == endpoint) {
+        this->m_endpoints.erase(found);
+    }
+}
+
+void Multiplexer::closeAccepted(MuxEndpoint *endpoint) {
+    if (endpoint == nullptr || !endpoint->m_accepted) {
+        return;
+    }
+    // The frames received before are still handled by the node serving it.
+    endpoint->m_closed = true;
+    endpoint->m_received.notify();
+    this->m_endpoints.erase(endpoint->m_id);
+}
+
+size_t Multiplexer::send(const FrameBatch &batch, const PeerAddress &peer) {
+    lock_guard<mutex> lock(this->m_sendMutex);
+    return this->m_transport->sendBatchTo(batch, peer);
+}
+
+void Multiplexer::expireEndpoints(chrono::steady_clock::time_point now) {
+    lock_guard<mutex> lock(this->m_endpointsMutex);
+    for (auto it = this->m_endpoints.begin(); it != this->m_endpoints.end();) {
+        MuxEndpoint *endpoint = it->second;
+        ++it;
+        if (now - endpoint->m_lastReceived > chrono::seconds(this->m_idleTimeout)) {
+            this->closeAccepted(endpoint);
+        }
+    }
+}
+
+void Multiplexer::receiveLoop() {
+    // Endpoints opened by the other node during a batch, handed to the acceptor once the endpoints are unlocked.
+    vector<pair<unique_ptr<Transport>, uint32_t>> accepted;
+    auto now = chrono::steady_clock::now();
+    auto route = [this, &accepted, &now](const C_BYTE *frame, size_t size, const PeerAddress& peer) {
+        if (size <= this->m_headerSize || frame[0] != this->m_delimiter) {
+            // Noise, or a node that doesn't use this mux.
+            return;
+        }
+
+        uint32_t id = 0;
+        for (size_t i = 1; i <= this->m_idSize; i++) {
+            id = (id << 8) | frame[i];
+        }
+        lock_guard<mutex> lock(this->m_endpointsMutex);
+        auto found = this->m_endpoints.find(id);
+        MuxEndpoint *endpoint = found == this->m_endpoints.end() ? nullptr : found->second;
+        if (!this->admit(endpoint, frame + this->m_headerSize, size - this->m_headerSize, peer)) {
+            return;
+        }
+        if (endpoint == nullptr) {
+            if (!this->m_acceptor) {
+                return;
+            }
+            if (this->m_endpoints.size() >= this->m_maxEndpoints) {
+                this->m_dropped++;
+                return;
+            }
+            endpoint = this->newEndpoint(id, peer, true);
+            this->m_endpoints[id] = endpoint;
+            accepted.emplace_back(unique_ptr<Transport>(endpoint), id);
+        }
+        endpoint->m_lastReceived = now;
+        if (!endpoint->m_received.push(frame + this->m_headerSize, size - this->m_headerSize)) {
+            this->m_dropped++;
+        }
+        endpoint->m_received.notify();
+    };
+
+    auto lastExpiration = now;
+    while (!this->m_stopping) {
+        now = chrono::steady_clock::now();
+        this->m_transport->receiveBatchFrom(route, MUX_BATCH_SIZE);
+
+        if (!accepted.empty()) {
+            Acceptor acceptor;
+            {
+                lock_guard<mutex> lock(this->m_endpointsMutex);
+                acceptor = this->m_acceptor;
+            }
+            for (auto& endpoint : accepted) {
+                acceptor(move(endpoint.first), endpoint.second);
+            }
+            accepted.clear();
+        }
+
+        if (now - lastExpiration > chrono::seconds(1)) {
+            this->expireEndpoints(now);
+            lastExpiration = now;
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef REDES_1_T1_MULTIPLEXER_H
+#define REDES_1_T1_MULTIPLEXER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "FrameQueue.h"
+
+/// \brief Most frames taken from the link at once.
+#define MUX_BATCH_SIZE 64
+/// \brief How long the receiving thread waits for the link before checking if it must stop, in milliseconds.
+#define MUX_POLL_INTERVAL 20
+
+class Multiplexer;
+
+/**
+ * @brief One of the endpoints of a link shared by a Multiplexer. To the node using it, it is a transport of its own:
+ * it only receives the frames with its id, which the receiving thread of the mux routes to its queue.
+ */
+class MuxEndpoint: public Transport {
+public:
+    /// \brief Frames received with its id from now on are dropped (or accepted as a new endpoint).
+    ~MuxEndpoint() override;
+
+    long sendFrame(const C_BYTE *frame, size_t size) override;
+    /// \throw The exception of throwClosed() if the endpoint was closed.
+    long receiveFrame(C_BYTE *buffer, size_t size) override;
+    void setReceiveTimeout(long milliseconds) override { m_receiveTimeout = milliseconds; }
+
+    size_t sendBatch(const FrameBatch& batch) override;
+    /// \throw The exception of throwClosed() if the endpoint was closed.
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames) override;
+
+    bool echoesOwnFrames() const override;
+    /// \brief The frames of the link, minus the header of the mux.
+    size_t maxFrameSize() const override;
+    /// \brief Nothing to do, the receiving thread always takes frames of up to the largest size of the link.
+    void setFrameSize(size_t) override {}
+
+    /// \brief The node whose frames reach the endpoint and where its frames are sent, empty for the other node of
+    /// the link.
+    const PeerAddress& peer() const { return m_peer; }
+
+protected:
+    MuxEndpoint(Multiplexer& mux, uint32_t id, const PeerAddress& peer, bool accepted, size_t queueSize) :
+            m_mux(mux), m_id(id), m_accepted(accepted), m_peer(peer), m_received(queueSize) {}
+
+    Multiplexer& m_mux;
+    uint32_t m_id;
+    /// \brief true if the endpoint was opened by the other node, only those are closed by the mux.
+    bool m_accepted;
+    /// \brief Frames being sent with the header of the mux in front, reused between calls.
+    FrameBatch m_sendBatch;
+
+    /// \brief Called by the receive methods when nothing was received and the endpoint was closed by the mux.
+    virtual void throwClosed() const = 0;
+    /// \brief Append a frame of size bytes with the header of the mux in front to m_sendBatch.
+    /// \return Where the frame must be written.
+    C_BYTE *appendFrame(size_t size);
+    /// \brief Send m_sendBatch to the peer of the endpoint.
+    size_t sendFrames();
+
+private:
+    friend class Multiplexer;
+
+    PeerAddress m_peer;
+    /// \brief Frames routed to this endpoint by the receiving thread of the mux, without the header.
+    FrameQueue m_received;
+    long m_receiveTimeout = -1;
+
+    /// \brief When the last frame of the endpoint was received, only used by the receiving thread of the mux.
+    chrono::steady_clock::time_point m_lastReceived = chrono::steady_clock::now();
+    /// \brief Set by the receiving thread of the mux when the endpoint was closed.
+    atomic<bool> m_closed{false};
+};
+
+/**
+ * @brief Shares a single link between several endpoints, each used by a node of its own (usually in a thread of its
+ * own). Every frame starts with a delimiter of the mux and the id of its endpoint, big endian. A thread of the mux
+ * reads the link and routes each frame to the queue of its endpoint, opening one for ids no endpoint uses if there is
+ * an acceptor, and sends are serialized on the link.
+ *
+ * Subclasses pick the delimiter and width of the ids, create their endpoints and may drop frames before they are
+ * routed (see admit()). They call start() once constructed and stop() when destroyed, since the receiving thread
+ * calls them.
+ */
+class Multiplexer {
+public:
+    /// \brief Called by the receiving thread of the mux with an endpoint opened by the other node, and its id. Must
+    /// return quickly, frames of every endpoint wait for it.
+    typedef function<void(unique_ptr<Transport> endpoint, uint32_t id)> Acceptor;
+
+    /// \brief Every endpoint must be closed before.
+    virtual ~Multiplexer();
+
+    bool echoesOwnFrames() const { return m_transport->echoesOwnFrames(); }
+    size_t maxFrameSize() const { return m_transport->maxFrameSize() - m_headerSize; }
+
+    /// \brief Frames dropped because the queue of their endpoint was full, or by admit().
+    size_t droppedFrames() const { return m_dropped; }
+
+protected:
+    /**
+     * @param transport The link shared by the endpoints, only used by the mux from now on.
+     * @param delimiter First byte of every frame of the mux, frames starting with anything else are dropped.
+     * @param idSize Bytes of the id after the delimiter.
+     * @param maxEndpoints Endpoints open at once, frames of new endpoints are dropped until one of them is closed.
+     * @param idleTimeout An accepted endpoint that receives nothing for this long (in seconds) is closed.
+     */
+    Multiplexer(unique_ptr<Transport> transport, C_BYTE delimiter, size_t idSize, size_t maxEndpoints,
+                long idleTimeout);
+
+    /// \brief Start and stop the receiving thread.
+    void start();
+    void stop();
+
+    /// \brief Open the endpoint with the given id, created by newEndpoint().
+    /// \return nullptr if the endpoint is already open.
+    unique_ptr<MuxEndpoint> open(uint32_t id);
+    /// \brief Open an endpoint for each id that receives a frame while no endpoint uses it, and hand it to acceptor
+    /// with that frame already queued. Without an acceptor those frames are dropped.
+    void accept(Acceptor acceptor);
+
+    /// \brief Create the endpoint of an id, opened by the other node if accepted.
+    virtual MuxEndpoint *newEndpoint(uint32_t id, const PeerAddress& peer, bool accepted) = 0;
+    /// \brief Called by the receiving thread, with the endpoints locked, for each frame of the mux before it is
+    /// routed to endpoint (nullptr if no endpoint uses its id).
+    /// \param frame The frame after the header.
+    /// \param peer The node that sent it, see Transport::receiveBatchFrom.
+    /// \return false if the frame must be dropped.
+    virtual bool admit(MuxEndpoint *endpoint, const C_BYTE *frame, size_t size, const PeerAddress& peer) = 0;
+    /// \brief Close endpoint if it was opened by the other node, the node serving it sees it the next time it finds no
+    /// frames. Must be called with the endpoints locked (e.g. from admit()).
+    void closeAccepted(MuxEndpoint *endpoint);
+
+    atomic<size_t> m_dropped{0};
+
+private:
+    friend class MuxEndpoint;
+
+    unique_ptr<Transport> m_transport;
+    mutex m_sendMutex;
+    C_BYTE m_delimiter;
+    size_t m_idSize;
+    size_t m_headerSize;
+    size_t m_maxEndpoints;
+    long m_idleTimeout;
+
+    /// \brief Open endpoints by id, guarded by m_endpointsMutex since endpoints are opened and closed by other
+    /// threads.
+    mutex m_endpointsMutex;
+    unordered_map<uint32_t, MuxEndpoint *> m_endpoints;
+    Acceptor m_acceptor;
+
+    atomic<bool> m_stopping{false};
+    thread m_receiver;
+
+    void receiveLoop();
+    /// \brief Close the accepted endpoints that received nothing for m_idleTimeout, so their ids and their nodes are
+    /// released.
+    void expireEndpoints(chrono::steady_clock::time_point now);
+    /// \brief Send frames that already have the header to peer.
+    size_t send(const FrameBatch& batch, const PeerAddress& peer);
+    void close(MuxEndpoint *endpoint);
+};
+
+
+#endif //REDES_1_T1_MULTIPLEXER_H
@@ -1,153 +1,555 @@
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
 #include "NetworkNode.h"
-#include "ConexaoRawSocket.h"
-#include "RawSocketIncludes.h"
+#include "Compression.h"
+#include "../FileHandler/AsyncFileIO.h"
+#include "../FileHandler/ChunkStore.h"
+#include "../FileHandler/FileDelta.h"
 #include "../FileHandler/fileHandler.h"
 
 unsigned char NetworkNode::message_delimiter = BEGIN_DELIMITER;
+bool NetworkNode::echo_transport = false;
 
-NetworkNode::NetworkNode() {
-    this->m_socket = ConexaoRawSocket(DEVICE);
+NetworkNode::NetworkNode() : NetworkNode(Transport::create(DEFAULT_TRANSPORT)) {}
+
+NetworkNode::NetworkNode(unique_ptr<Transport> transport) : m_transport(move(transport)) {
     this->logger = Logger::getInstance();
 
-    struct timeval tv;
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    setsockopt(this->m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
-//    setsockopt(this->m_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv);
+    int descriptor = this->m_transport->pollDescriptor();
+    if (descriptor != -1) {
+        try {
+            this->m_events = make_unique<EventLoop>();
+            this->m_events->watch(descriptor);
+            this->m_transport->setReceiveTimeout(EVENT_RECEIVE_TIMEOUT);
+        }
+        catch (runtime_error& error) {
+            logger->warn(string("Waiting on the transport instead of an event loop: ") + error.what());
+            this->m_events.reset();
+        }
+    }
+}
+
+bool NetworkNode::negotiate(const LinkOptions &proposal) {
+    logger->info("Negotiating the link options.");
+    LinkOptions options = proposal;
+    options.maxFrameSize = min(options.maxFrameSize, this->m_transport->maxFrameSize());
+    this->m_sendQueue.emplace_back(MessageType::NEGOTIATE, 0, options.negotiated().toBytes());
+    this->m_sendQueue.emplace_back(MessageType::END, 1);
+    this->sendSequence();
+    this->waitSequence(false);
+
+    if (this->m_receivedQueue.front().getType() != MessageType::NEGOTIATE) {
+        logger->error("The other node refused the link options: " + this->getLongStringMessageData());
+        this->popEndMessage();
+        return false;
+    }
+
+    LinkOptions accepted = LinkOptions::fromBytes(this->m_receivedQueue.front().getData());
+    this->m_receivedQueue.pop();
+    this->popEndMessage();
+    this->setLinkOptions(accepted);
+    return true;
+}
+
+void NetworkNode::setLinkOptions(const LinkOptions &options) {
+    this->m_options = options.negotiated();
+    this->m_transport->setFrameSize(this->m_options.maxFrameSize);
+    logger->info("Using " + string(this->m_options.arqMode == ArqMode::SELECTIVE_REPEAT ? "selective repeat" : "go-back-N") +
+                 " with a window of " + to_string(this->m_options.windowSize) + " messages, the " +
+                 (this->m_options.extendedHeader ? "extended" : "normal") + " header, " +
+                 (this->m_options.crc ? "CRC-32C" : "parity") + " checks and frames of up to " +
+                 to_string(this->m_options.maxFrameSize) + " bytes" +
+                 (this->m_options.compression ? ", compressing files and listings." : "."));
+}
+
+bool NetworkNode::handleNegotiate() {
+    LinkOptions accepted = LinkOptions::fromBytes(this->m_receivedQueue.front().getData());
+    accepted.maxFrameSize = min(accepted.maxFrameSize, this->m_transport->maxFrameSize());
+    accepted = accepted.negotiated();
+    this->m_receivedQueue.pop();
+
+    // A client negotiates as soon as it starts, with the defaults, while we may still use the options of a previous
+    // client (e.g. one that was restarted). The answer uses the defaults too, the client only switches once it is
+    // received, and the previous window of its sequence stays acknowledged if our last ACK is lost.
+    this->setLinkOptions(LinkOptions());
+    this->m_sendQueue.emplace_back(MessageType::NEGOTIATE, 0, accepted.toBytes());
+    this->m_sendQueue.emplace_back(MessageType::END, 1);
+    this->sendSequence();
+    this->setLinkOptions(accepted);
+    return true;
 }
 
 bool NetworkNode::sendSequence() {
+    if (this->m_options.arqMode == ArqMode::SELECTIVE_REPEAT) {
+        return this->sendSequenceSelectiveRepeat();
+    }
+    return this->sendSequenceGoBackN();
+}
+
+bool NetworkNode::receiveSequence() {
+    if (this->m_options.arqMode == ArqMode::SELECTIVE_REPEAT) {
+        return this->receiveSequenceSelectiveRepeat();
+    }
+    return this->receiveSequenceGoBackN();
+}
+
+bool NetworkNode::sendSequenceGoBackN() {
     logger->info("Sending sequence of messages.");
 
     bool sequenceSent = false;
     unsigned long seqStart = 0;
-    unsigned long queueIdx = 0;
+    // The window always starts at the front of the queue, acknowledged messages are removed from it.
+    // The first sentUntil messages of the queue were already sent at least once.
+    unsigned long sentUntil = 0;
+    unsigned long sentCount = 0;
+    // Messages of the received buffer already handled, they are only removed from it once the sequence is sent.
+    size_t processed = 0;
 
     this->lastMessageReceived.reset();
+    this->fillSendQueue(this->m_options.windowSize);
     while (!this->m_sendQueue.empty() && !sequenceSent) {
-        for (unsigned long i = queueIdx; i < queueIdx + WINDOW_SIZE; i++) {
-            this->sendMessage(this->m_sendQueue[i]);
+        this->m_sendBatch.clear();
+        for (unsigned long i = 0; i < this->m_options.windowSize && i < this->m_sendQueue.size(); i++) {
+            this->m_sendQueue[i].setExtended(this->m_options.extendedHeader, this->m_options.crc);
+            const Message& message = this->m_sendQueue[i];
+            message.encode(this->m_sendBatch.append(message.getFrameSize()), message.getFrameSize());
+            logger->debug("Sending message: " + (string)this->m_sendQueue[i]);
             if (this->m_sendQueue[i].getType() == MessageType::END) {
                 break;
             }
         }
+        this->m_transport->sendBatch(this->m_sendBatch);
+        // Karn's rule: the round trip of a window that was sent before can't be measured.
+        bool retransmission = sentUntil > 0;
+        sentUntil = max(sentUntil, static_cast<unsigned long>(this->m_sendBatch.size()));
 
+        unsigned long accepted = 0;
         auto startTime = chrono::steady_clock::now();
         while (true) {
-            receiveMessage();
-            if (!m_receivedBuffer.empty()) {
-                Message received = m_receivedBuffer.front();
-                m_receivedBuffer.erase(m_receivedBuffer.begin());
-
-                if (received.getType() == MessageType::ACK) {
-                    unsigned long acceptedId = received.getDataAsUl();
-                    if (acceptedId >= seqStart) {
-                        queueIdx = queueIdx + acceptedId - seqStart + 1;
-                    }
-                    else {
-                        queueIdx = queueIdx + ((seqStart + acceptedId + 2) % MAX_SEQ_COUNT) + 1;
-                    }
-                    seqStart = (acceptedId + 1) % MAX_SEQ_COUNT;
-                    break;
-                } else if (received.getType() == MessageType::NACK) {
-                    unsigned long acceptedId = received.getDataAsUl();
-                    if (acceptedId >= seqStart) {
-                        queueIdx = queueIdx + acceptedId - seqStart;
-                    }
-                    else {
-                        queueIdx = queueIdx + ((seqStart + acceptedId) % MAX_SEQ_COUNT);
+            // Frames may already be waiting (e.g. resent by the other node after we accepted its last sequence),
+            // only wait for new ones once they were all handled.
+            if (processed == this->m_receivedBuffer.size()) {
+                this->m_receivedBuffer.clear();
+                processed = 0;
+                this->receiveMessages(startTime + this->m_rtt.timeout());
+            }
+            if (processed < this->m_receivedBuffer.size()) {
+                const Message& received = this->m_receivedBuffer[processed++];
+
+                unsigned long nextSeq;
+                if (!this->acknowledgedSequence(received, nextSeq)) {
+                    this->acknowledgePreviousWindow(received);
+                }
+                else {
+                    // Messages accepted from the start of the window, ignoring (old) answers that don't fall inside
+                    // it. An ACK accepts at least one message, a NACK or SACK of the first one asks for it again.
+                    unsigned long acceptedCount = this->sequenceDistance(seqStart, nextSeq);
+                    if (acceptedCount <= this->m_sendBatch.size() &&
+                        (acceptedCount > 0 || received.getType() != MessageType::ACK)) {
+                        // Only a full window is acknowledged right away, otherwise the receiver waited for its timer.
+                        if (!retransmission && acceptedCount == this->m_sendBatch.size()) {
+                            this->m_rtt.addSample(chrono::duration_cast<chrono::microseconds>(
+                                    chrono::steady_clock::now() - startTime));
+                        }
+                        accepted = acceptedCount;
+                        seqStart = nextSeq;
+                        break;
                     }
-                    seqStart = acceptedId;
-                    break;
                 }
             }
 
-            auto timeElapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
-            if (timeElapsed > TIMEOUT) {
+            if (chrono::steady_clock::now() - startTime > this->m_rtt.timeout()) {
                 logger->warn("Timeout while waiting for ACK/NACK. Trying to send the message again.");
+                this->m_rtt.backoff();
                 break;
             }
         }
 
-        if (queueIdx > 0 && m_sendQueue[queueIdx-1].getType() == MessageType::END) {
-            sequenceSent = true;
-            this->m_sendQueue.erase(this->m_sendQueue.begin(), this->m_sendQueue.begin() + queueIdx);
-            logger->info("Full sequence sent successfully, returning. " + to_string(queueIdx));
+        if (accepted > 0) {
+            sequenceSent = this->m_sendQueue[accepted - 1].getType() == MessageType::END;
+            this->m_sendQueue.erase(this->m_sendQueue.begin(), this->m_sendQueue.begin() + accepted);
+            sentCount += accepted;
+            sentUntil = sentUntil > accepted ? sentUntil - accepted : 0;
+            this->fillSendQueue(this->m_options.windowSize);
         }
     }
+    // Once the whole sequence is acknowledged the other node starts its own sequence, which must be kept.
+    this->m_receivedBuffer.erase(this->m_receivedBuffer.begin(), this->m_receivedBuffer.begin() + processed);
+    this->m_previousWindow.clear();
+    this->m_previousSack.reset();
+    logger->info("Full sequence sent successfully, returning. " + to_string(sentCount));
 
     return true;
 }
 
 bool NetworkNode::sendMessage(Message message) {
-    auto vectorMessage = message.toCharVector();
-    long int status = send(this->m_socket, vectorMessage.data(), vectorMessage.size(), 0);
+    message.setExtended(this->m_options.extendedHeader, this->m_options.crc);
+    this->m_frameBuffer.resize(message.getFrameSize());
+    message.encode(this->m_frameBuffer.data(), this->m_frameBuffer.size());
+    long int status = this->m_transport->sendFrame(this->m_frameBuffer.data(), this->m_frameBuffer.size());
 
     logger->debug("Sending message: " + (string)message);
-    return status == message.getSize();
+    return status == static_cast<long>(this->m_frameBuffer.size());
 }
 
-bool NetworkNode::receiveSequence() {
+bool NetworkNode::receiveSequenceGoBackN() {
     logger->info("Waiting message sequence.");
     unsigned long startSeq = 0;
     auto startTime = chrono::steady_clock::now();
+    // The time between our ACK and the next window is a round trip, used when we only receive.
+    bool waitingNextWindow = false;
+
+    // Accept the received window and answer it, returns true if it was accepted.
+    auto acknowledge = [this, &startSeq]() {
+        unsigned long nextSeq = this->handleReceivedBuffer(startSeq);
+        if (nextSeq == startSeq) {
+            this->sendMessage(Message(MessageType::NACK, 0, startSeq));
+            return false;
+        }
+
+        unsigned long acceptedSequence = (nextSeq + this->m_options.sequenceSpace() - 1) %
+                                         this->m_options.sequenceSpace();
+        Message ack(MessageType::ACK, 0, acceptedSequence);
+        this->sendMessage(ack);
+        startSeq = nextSeq;
+        // Kept in case the ACK of the last window is lost, see acknowledgePreviousWindow.
+        if (this->m_acceptedWindow[this->m_acceptedWindow.count() - 1].getType() == MessageType::END) {
+            swap(this->m_previousWindow, this->m_acceptedWindow);
+            this->m_previousSack = make_unique<Message>(ack);
+        }
+        return true;
+    };
+    // A whole window (or the end of the sequence) was received, so it can be acknowledged right away.
+    auto windowReceived = [this]() {
+        return this->m_receivedBuffer.size() >= this->m_options.windowSize ||
+               (!this->m_receivedBuffer.empty() && this->m_receivedBuffer.back().getType() == MessageType::END);
+    };
 
     while (m_receivedQueue.empty() || !(m_receivedQueue.back().getType() == MessageType::END ||
                                         m_receivedQueue.back().getType() == MessageType::ACK ||
                                         m_receivedQueue.back().getType() == MessageType::NACK)) {
-        this->receiveMessage();
+        // A window kept from the end of our last sequence (the other node answered right away) may already be whole,
+        // waiting for more frames would only delay its acknowledgement until the other node times out.
+        // Nothing to acknowledge until a window starts arriving, so there is no timer to wake up for.
+        bool idle = this->m_receivedBuffer.empty();
+        if (!windowReceived()) {
+            this->receiveMessages(idle ? chrono::steady_clock::time_point::max() : startTime + this->m_rtt.timeout());
+        }
+        if (idle && !this->m_receivedBuffer.empty()) {
+            auto now = chrono::steady_clock::now();
+            if (waitingNextWindow && now - startTime <= this->m_rtt.timeout()) {
+                this->m_rtt.addSample(chrono::duration_cast<chrono::microseconds>(now - startTime));
+            }
+            waitingNextWindow = false;
+            // The timer of a window starts with its first message.
+            startTime = now;
+        }
 
-        if (this->m_receivedBuffer.size() == WINDOW_SIZE ||
-            (!this->m_receivedBuffer.empty() && this->m_receivedBuffer.back().getType() == MessageType::END))
-        {
+        if (windowReceived()) {
             logger->debug("Received a full sequence.");
-            unsigned long nextSeq = this->handleReceivedBuffer(startSeq);
-            if (nextSeq != startSeq) {
-                unsigned long acceptedSequence = nextSeq == 0 ? MAX_SEQ : nextSeq - 1;
-                this->sendMessage(Message(MessageType::ACK, 0, acceptedSequence));
-                startSeq = nextSeq;
-            }
-            else {
-                this->sendMessage(Message(MessageType::NACK, 0, startSeq));
-            }
+            waitingNextWindow = acknowledge();
 
             startTime = chrono::steady_clock::now();
         }
 
-        auto timeElapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - startTime).count();
-        if (timeElapsed > TIMEOUT) {
+        if (chrono::steady_clock::now() - startTime > this->m_rtt.timeout()) {
             if (!this->m_receivedBuffer.empty()) {
                 logger->warn("Timeout while waiting for messages, sending ack/nack.");
-                unsigned long nextSeq = this->handleReceivedBuffer(startSeq);
-                if (nextSeq != startSeq) {
-                    unsigned long acceptedSequence = nextSeq == 0 ? MAX_SEQ : nextSeq - 1;
-                    this->sendMessage(Message(MessageType::ACK, 0, acceptedSequence));
-                    startSeq = nextSeq;
-                } else {
-                    this->sendMessage(Message(MessageType::NACK, 0, startSeq));
-                }
+                acknowledge();
             }
             startTime = chrono::steady_clock::now();
+            waitingNextWindow = false;
+        }
+    }
+
+    return true;
+}
+
+bool NetworkNode::sendSequenceSelectiveRepeat() {
+    logger->info("Sending sequence of messages.");
+
+    struct SentMessage {
+        /// \brief Order of the last transmission of the message, 0 if it wasn't sent yet.
+        unsigned long transmission = 0;
+        unsigned int sendCount = 0;
+        chrono::steady_clock::time_point sentAt;
+        bool acknowledged = false;
+    };
+    // State of the first messages of the send queue, acknowledged messages are removed from both.
+    SlidingWindow<SentMessage> window(this->m_options.windowSize);
+    bool sequenceSent = false;
+    size_t sentCount = 0;
+    unsigned long transmissionCount = 0;
+    // A message transmitted before the last acknowledged transmission was lost, no need to wait for its timer.
+    unsigned long lastAcknowledgedTransmission = 0;
+
+    // Most recent transmission acknowledged by the SACK being handled that can be used as a round trip sample.
+    chrono::steady_clock::time_point rttSampleSentAt;
+
+    auto acknowledge = [&](SentMessage& sent) {
+        if (!sent.acknowledged) {
+            sent.acknowledged = true;
+            lastAcknowledgedTransmission = max(lastAcknowledgedTransmission, sent.transmission);
+            // Karn's rule: the acknowledgement of a resent message can't be matched to one of its transmissions.
+            if (sent.sendCount == 1) {
+                rttSampleSentAt = max(rttSampleSentAt, sent.sentAt);
+            }
+        }
+    };
+
+    this->lastMessageReceived.reset();
+    while (!sequenceSent) {
+        this->fillSendQueue(this->m_options.windowSize);
+        while (window.count() < window.capacity() && window.count() < this->m_sendQueue.size() &&
+               (window.empty() || this->m_sendQueue[window.count() - 1].getType() != MessageType::END)) {
+            window.insert(window.count(), SentMessage());
+        }
+        if (window.empty()) {
+            break;
+        }
+
+        auto now = chrono::steady_clock::now();
+        bool timedOut = false;
+        // Transmission of the oldest message still waiting for a SACK, its timer is the next one to expire.
+        chrono::steady_clock::time_point oldestSentAt = chrono::steady_clock::time_point::max();
+        this->m_sendBatch.clear();
+        for (size_t i = 0; i < window.count(); i++) {
+            SentMessage& sent = window[i];
+            bool expired = sent.transmission != 0 && !sent.acknowledged && now - sent.sentAt > this->m_rtt.timeout();
+            bool lost = sent.transmission != 0 && !sent.acknowledged &&
+                        (sent.transmission < lastAcknowledgedTransmission || expired);
+            timedOut = timedOut || expired;
+            if (sent.transmission == 0 || lost) {
+                Message& message = this->m_sendQueue[i];
+                logger->debug((lost ? "Resending message: " : "Sending message: ") + (string)message);
+                message.setExtended(this->m_options.extendedHeader, this->m_options.crc);
+                message.encode(this->m_sendBatch.append(message.getFrameSize()), message.getFrameSize());
+                sent.transmission = ++transmissionCount;
+                sent.sendCount++;
+                sent.sentAt = now;
+            }
+            if (!sent.acknowledged) {
+                oldestSentAt = min(oldestSentAt, sent.sentAt);
+            }
+        }
+        if (timedOut) {
+            logger->warn("Timeout while waiting for SACK. Sending the missing messages again.");
+            this->m_rtt.backoff();
+        }
+        if (!this->m_sendBatch.empty()) {
+            this->m_transport->sendBatch(this->m_sendBatch);
+        }
+
+        this->receiveMessages(oldestSentAt == chrono::steady_clock::time_point::max() ?
+                              oldestSentAt : oldestSentAt + this->m_rtt.timeout());
+        size_t processed = 0;
+        while (processed < this->m_receivedBuffer.size() && !sequenceSent && !window.empty()) {
+            const Message& received = this->m_receivedBuffer[processed++];
+            unsigned long nextSeq;
+            if (!this->acknowledgedSequence(received, nextSeq)) {
+                this->acknowledgePreviousWindow(received);
+                continue;
+            }
+
+            size_t acceptedCount = this->sequenceDistance(this->m_sendQueue.front().getSequenceId(), nextSeq);
+            if (acceptedCount > window.count()) {
+                logger->debug("Ignoring an old answer: " + (string)received);
+                continue;
+            }
+
+            for (size_t i = 0; i < acceptedCount; i++) {
+                acknowledge(window[i]);
+            }
+            // Go-back-N answers only accept the messages before nextSeq.
+            const C_BYTE *sack = received.getDataBytes();
+            size_t bitmapBits = received.getType() == MessageType::SACK ?
+                                (received.getDataSize() - SACK_BASE_SIZE) * BYTE : 0;
+            for (size_t bit = 0; bit < bitmapBits; bit++) {
+                size_t i = acceptedCount + 1 + bit;
+                if (i < window.count() && (sack[SACK_BASE_SIZE + bit / BYTE] >> (bit % BYTE)) & 1) {
+                    acknowledge(window[i]);
+                }
+            }
+
+            if (rttSampleSentAt != chrono::steady_clock::time_point()) {
+                this->m_rtt.addSample(chrono::duration_cast<chrono::microseconds>(
+                        chrono::steady_clock::now() - rttSampleSentAt));
+                rttSampleSentAt = chrono::steady_clock::time_point();
+            }
+
+            while (!window.empty() && window[0].acknowledged) {
+                sequenceSent = this->m_sendQueue.front().getType() == MessageType::END;
+                window.popFront();
+                this->m_sendQueue.pop_front();
+                sentCount++;
+            }
         }
+        // Once the whole sequence is acknowledged the other node starts its own sequence, which must be kept.
+        this->m_receivedBuffer.erase(this->m_receivedBuffer.begin(), this->m_receivedBuffer.begin() + processed);
     }
 
+    this->m_previousWindow.clear();
+    this->m_previousSack.reset();
+    logger->info("Full sequence sent successfully, returning. " + to_string(sentCount));
     return true;
 }
 
-bool NetworkNode::receiveMessage() {
-    C_BYTE data[MAX_SIZE];
-    long int bytesReceived = recv(this->m_socket, data, 64, 0);
-    if (bytesReceived < MIN_SIZE || data[0] != NetworkNode::message_delimiter) {
+bool NetworkNode::receiveSequenceSelectiveRepeat() {
+    logger->info("Waiting message sequence.");
+
+    unsigned long nextSeq = 0;
+    this->m_reorderWindow.reset(this->m_options.windowSize);
+    this->m_acceptedWindow.reset(this->m_options.windowSize);
+
+    bool sequenceEnded = false;
+    while (!sequenceEnded) {
+        // Messages may already be waiting, received while we were finishing our own sequence.
+        // The sender has the timers, we only answer what arrives.
+        if (this->m_receivedBuffer.empty()) {
+            this->receiveMessages(chrono::steady_clock::time_point::max());
+        }
+
+        bool receivedData = false;
+        for (const auto& received : this->m_receivedBuffer) {
+            MessageType type = received.getType();
+            if (type == MessageType::ACK || type == MessageType::NACK || type == MessageType::SACK ||
+                this->acknowledgePreviousWindow(received)) {
+                continue;
+            }
+
+            // Even duplicates must be acknowledged, the sender only resends a message if it didn't get our SACK.
+            receivedData = true;
+            this->m_reorderWindow.insert(this->sequenceDistance(nextSeq, received.getSequenceId()), received);
+        }
+        this->m_receivedBuffer.clear();
+
+        while (this->m_reorderWindow.contains(0) && !sequenceEnded) {
+            Message& message = this->m_reorderWindow[0];
+            sequenceEnded = message.getType() == MessageType::END;
+            this->acceptMessage(message);
+            this->m_acceptedWindow.pushBack(move(message));
+            this->m_reorderWindow.popFront();
+            nextSeq = (nextSeq + 1) % this->m_options.sequenceSpace();
+        }
+
+        if (receivedData) {
+            Message sack = this->sendSack(nextSeq, this->m_reorderWindow);
+            if (sequenceEnded) {
+                swap(this->m_previousWindow, this->m_acceptedWindow);
+                this->m_previousSack = make_unique<Message>(sack);
+            }
+        }
+    }
+
+    return true;
+}
+
+Message NetworkNode::sendSack(unsigned long nextSeq, const SlidingWindow<Message> &reorderWindow) {
+    // The next expected message (32 bits), then one bit for each message of the window after it. Messages that don't
+    // fit in the bitmap are only acknowledged once nextSeq moves past them.
+    size_t bitmapSize = min((reorderWindow.capacity() + BYTE - 2) / BYTE,
+                            this->m_options.maxDataSize() - SACK_BASE_SIZE);
+    vector<C_BYTE> sack(SACK_BASE_SIZE + bitmapSize, 0);
+    for (size_t i = 0; i < SACK_BASE_SIZE; i++) {
+        sack[i] = static_cast<C_BYTE>(nextSeq >> (BYTE * (SACK_BASE_SIZE - 1 - i)));
+    }
+    for (size_t i = 1; i < min(reorderWindow.capacity(), 1 + bitmapSize * BYTE); i++) {
+        if (reorderWindow.contains(i)) {
+            sack[SACK_BASE_SIZE + (i - 1) / BYTE] |= static_cast<C_BYTE>(1 << ((i - 1) % BYTE));
+        }
+    }
+
+    Message message(MessageType::SACK, 0, move(sack));
+    this->sendMessage(message);
+    return message;
+}
+
+bool NetworkNode::acknowledgedSequence(const Message &message, unsigned long &nextSeq) const {
+    switch (message.getType()) {
+        case MessageType::ACK:
+            // Go-back-N acknowledges the last message accepted, and asks for the first one missing with a NACK.
+            nextSeq = (message.getDataAsUl() + 1) % this->m_options.sequenceSpace();
+            return true;
+        case MessageType::NACK:
+            nextSeq = message.getDataAsUl() % this->m_options.sequenceSpace();
+            return true;
+        case MessageType::SACK: {
+            if (message.getDataSize() < SACK_BASE_SIZE) {
+                return false;
+            }
+            const C_BYTE *sack = message.getDataBytes();
+            nextSeq = (static_cast<unsigned long>(sack[0]) << 24 | static_cast<unsigned long>(sack[1]) << 16 |
+                       static_cast<unsigned long>(sack[2]) << 8 | sack[3]) % this->m_options.sequenceSpace();
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool NetworkNode::acknowledgePreviousWindow(const Message &message) {
+    if (this->m_previousSack == nullptr || this->m_previousWindow.empty()) {
+        return false;
+    }
+    // The previous window is stored in order, so the message can only be at its distance from the first one.
+    size_t distance = this->sequenceDistance(this->m_previousWindow[0].getSequenceId(), message.getSequenceId());
+    if (!this->m_previousWindow.contains(distance) || this->m_previousWindow[distance] != message) {
+        return false;
+    }
+
+    logger->debug("Received a message of the previous sequence, sending its acknowledgement again.");
+    this->sendMessage(*this->m_previousSack);
+    return true;
+}
+
+bool NetworkNode::receiveMessages(chrono::steady_clock::time_point deadline) {
+    if (this->m_events != nullptr) {
+        // Sleep until a frame arrives or the next timer of the protocol expires.
+        if (!this->m_transport->hasPendingFrames() && !this->m_events->waitReadable(deadline)) {
+            return false;
+        }
+    }
+    else {
+        // The transport waits by itself, at most until the deadline.
+        long timeout = IDLE_RECEIVE_TIMEOUT;
+        if (deadline != chrono::steady_clock::time_point::max()) {
+            auto remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+            timeout = max(static_cast<long>(remaining.count()) + 1, 1L);
+        }
+        if (timeout != this->m_receiveTimeout) {
+            this->m_transport->setReceiveTimeout(timeout);
+            this->m_receiveTimeout = timeout;
+        }
+    }
+
+    bool receivedValid = false;
+    this->m_transport->receiveBatch([&](const C_BYTE *frame, size_t size) {
+        receivedValid = this->handleReceivedFrame(frame, size) || receivedValid;
+    }, min(this->m_options.windowSize, static_cast<unsigned long>(RECEIVE_BATCH_SIZE)));
+    return receivedValid;
+}
+
+bool NetworkNode::handleReceivedFrame(const C_BYTE *data, size_t bytesReceived) {
+    if (bytesReceived < MIN_SIZE || (data[0] != NetworkNode::message_delimiter &&
+                                     data[0] != (NetworkNode::message_delimiter ^ EXTENDED_DELIMITER_MASK))) {
         return false;
     }
 
-    Message received(data);
+    Message received(data, bytesReceived);
     if (received.constructionError) {
         return false;
     }
 
+    // Selective repeat detects duplicates by their sequence id, and must acknowledge them again.
+    if (this->m_options.arqMode == ArqMode::SELECTIVE_REPEAT) {
+        this->m_receivedBuffer.push_back(received);
+        logger->debug("Received message: " + (string)received);
+        return true;
+    }
+
     if (this->lastMessageReceived == nullptr || received != *(this->lastMessageReceived)) {
         this->m_receivedBuffer.push_back(received);
         this->lastMessageReceived = make_unique<Message>(received);
@@ -160,31 +562,47 @@ bool NetworkNode::receiveMessage() {
     }
 }
 
+unsigned long NetworkNode::sequenceDistance(unsigned long from, unsigned long to) const {
+    unsigned long space = this->m_options.sequenceSpace();
+    return (to % space + space - from % space) % space;
+}
+
 unsigned long NetworkNode::handleReceivedBuffer(unsigned long startSeq) {
-    sort(this->m_receivedBuffer.begin(), this->m_receivedBuffer.end(), [](const Message& a, const Message& b) {
-        if (a.getSequenceId() > 11 && b.getSequenceId() < 4) {
-            return true;
-        }
-        else if (b.getSequenceId() > 11 && a.getSequenceId() < 4) {
-            return false;
-        }
-        return a.getSequenceId() < b.getSequenceId();
-    });
+    // Place each message at its distance from the start of the window. The ones outside of it were already accepted
+    // (resent by the sender after its timer expired) or can't be accepted before the window moves.
+    this->m_reorderWindow.reset(this->m_options.windowSize);
+    this->m_acceptedWindow.reset(this->m_options.windowSize);
+    for (const auto& message : this->m_receivedBuffer) {
+        this->m_reorderWindow.insert(this->sequenceDistance(startSeq, message.getSequenceId()), message);
+    }
+    this->m_receivedBuffer.clear();
 
     unsigned long expectedSequenceId = startSeq;
-    for (const auto & message : this->m_receivedBuffer) {
-        if (message.getSequenceId() != expectedSequenceId) {
-            logger->info("Unexpected message " + to_string(message.getSequenceId()) + " received. Expected: " + to_string(expectedSequenceId));
-            break;
-        }
-        this->m_receivedQueue.push(message);
-        expectedSequenceId = (expectedSequenceId + 1) % MAX_SEQ_COUNT;
+    while (this->m_reorderWindow.contains(0)) {
+        this->acceptMessage(this->m_reorderWindow[0]);
+        this->m_acceptedWindow.pushBack(move(this->m_reorderWindow[0]));
+        this->m_reorderWindow.popFront();
+        expectedSequenceId = (expectedSequenceId + 1) % this->m_options.sequenceSpace();
+    }
+    if (!this->m_reorderWindow.empty()) {
+        logger->info("Unexpected messages received after a missing one. Expected: " + to_string(expectedSequenceId));
     }
-    this->m_receivedBuffer.clear();
 
     return expectedSequenceId;
 }
 
+void NetworkNode::acceptMessage(const Message &message) {
+    if (this->m_streamWriter && message.getType() == this->m_streamWriterType) {
+        // Keep accepting the data after a failure, so the sequence still ends normally.
+        if (!this->m_streamWriteFailed && !this->m_streamWriter(message.getDataBytes(), message.getDataSize())) {
+            logger->error("Could not store the received data.");
+            this->m_streamWriteFailed = true;
+        }
+        return;
+    }
+    this->m_receivedQueue.push(message);
+}
+
 bool NetworkNode::handleReceivedQueue() {
     if (this->m_receivedQueue.empty()) {
         return false;
@@ -224,6 +642,12 @@ bool NetworkNode::handleReceivedQueue() {
         case MessageType::PUT:
             executionResult = this->handlePUT();
             break;
+        case MessageType::GLOB:
+            executionResult = this->handleGlob();
+            break;
+        case MessageType::NEGOTIATE:
+            executionResult = this->handleNegotiate();
+            break;
         case MessageType::INVALID:
             break;
         default:
@@ -248,34 +672,283 @@ bool NetworkNode::waitSequence(bool handleReceived) {
 }
 
 bool NetworkNode::handleFileData(const string& filePath) {
+    if (!this->m_deltaBasis.empty()) {
+        return this->receiveDelta(filePath);
+    }
+    if (this->m_chunkedFile) {
+        return this->receiveChunks(filePath);
+    }
     logger->info("Writing file to " + filePath);
 
-    string fullFileData = this->getLongStringMessageData();
+    // Writes are queued to the disk without waiting for them, so the receiver keeps acknowledging windows.
+    FileCheckpoint& checkpoint = this->m_checkpoint;
+    AsyncFileWriter file(FileCheckpoint::partPath(filePath), static_cast<off_t>(checkpoint.done));
+    unsigned long savedAt = checkpoint.done;
+    this->receiveStream(MessageType::FILE_DATA, [&](const C_BYTE *data, size_t size) {
+        if (!file.write(reinterpret_cast<const char *>(data), size)) {
+            return false;
+        }
+        checkpoint.done += size;
+        if (checkpoint.done - savedAt >= CHECKPOINT_INTERVAL) {
+            // Only what is on the disk is counted, the writes of the last interval are still in flight.
+            if (!file.flush() || !checkpoint.save(filePath)) {
+                return false;
+            }
+            savedAt = checkpoint.done;
+        }
+        return true;
+    });
+    this->waitSequence(false);
+    bool result = !this->m_streamWriteFailed;
+    this->receiveStream(MessageType::INVALID, nullptr);
 
-    writeFile(filePath, fullFileData);
+    bool complete = result && checkpoint.done == checkpoint.length;
+    if (result && !complete && file.flush()) {
+        // The other node stopped early (e.g. its file couldn't be read), the next transfer continues from here.
+        logger->error("Only " + to_string(checkpoint.done) + " of " + to_string(checkpoint.length) +
+                      " bytes received, saving a checkpoint.");
+        checkpoint.save(filePath);
+    }
+    result = file.finish() && complete;
+    if (result) {
+        result = rename(FileCheckpoint::partPath(filePath).c_str(), filePath.c_str()) == 0;
+        FileCheckpoint::remove(filePath);
+    }
 
     this->popEndMessage();
-    return true;
+    return result;
+}
+
+bool NetworkNode::receiveDelta(const string &filePath) {
+    logger->info("Updating " + filePath + " with a delta.");
+
+    string deltaPath = filePath + DELTA_FILE_SUFFIX;
+    DeltaDecoder decoder(this->m_deltaBasis, this->m_deltaBlockSize, deltaPath);
+    this->m_deltaBasis.clear();
+    this->receiveStream(MessageType::DELTA, [&decoder](const C_BYTE *data, size_t size) {
+        return decoder.write(data, size);
+    });
+    this->waitSequence(false);
+    bool result = !this->m_streamWriteFailed;
+    this->receiveStream(MessageType::INVALID, nullptr);
+
+    result = decoder.finish() && result;
+    if (result) {
+        result = rename(deltaPath.c_str(), filePath.c_str()) == 0;
+    }
+    else {
+        logger->error("Could not rebuild " + filePath + " from the delta, keeping the old copy.");
+        remove(deltaPath.c_str());
+    }
+
+    this->popEndMessage();
+    return result;
 }
 
-string NetworkNode::handleFileDescriptor(const string &fileWritePath) {
+bool NetworkNode::receiveChunks(const string &filePath) {
+    logger->info("Receiving the chunks of " + filePath);
+    this->m_chunkedFile = false;
+    const ChunkStore& store = *this->m_chunkStore;
+
+    vector<C_BYTE> list;
+    this->receiveStream(MessageType::CHUNKS, [&list](const C_BYTE *data, size_t size) {
+        list.insert(list.end(), data, data + size);
+        return true;
+    });
+    this->waitSequence(false);
+    this->receiveStream(MessageType::INVALID, nullptr);
+    this->popEndMessage();
+
+    vector<FileChunk> chunks;
+    bool result = decodeChunks(list, chunks);
+    unsigned long total = chunks.empty() ? 0 : chunks.back().offset + chunks.back().size;
+    result = result && total == this->m_checkpoint.fileSize;
+
+    // Ask for the chunks not stored yet, once each even if the file repeats them. An invalid list asks for none, the
+    // other node still sends its (empty) data. Stored chunks are checked, a damaged one is removed and asked for.
+    string missing((chunks.size() + 7) / 8, '\0');
+    vector<FileChunk> requested;
+    unordered_set<string> requestedHashes;
+    vector<char> data;
+    for (size_t i = 0; result && i < chunks.size(); ++i) {
+        const FileChunk& chunk = chunks[i];
+        if (!store.get(chunk.hash, chunk.size, data) &&
+            requestedHashes.insert(string(reinterpret_cast<const char *>(chunk.hash), CHUNK_HASH_SIZE)).second) {
+            missing[i / 8] = static_cast<char>(missing[i / 8] | (1 << (i % 8)));
+            requested.push_back(chunk);
+        }
+    }
+    this->enqueueLongStringMessageData(MessageType::CHUNKS, 0, missing);
+    this->sendSequence();
+
+    size_t next = 0;
+    vector<char> chunkData;
+    this->receiveStream(MessageType::FILE_DATA, [&](const C_BYTE *data, size_t size) {
+        while (size > 0) {
+            if (next == requested.size()) {
+                return false;
+            }
+            const FileChunk& chunk = requested[next];
+            size_t count = min(size, chunk.size - chunkData.size());
+            chunkData.insert(chunkData.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (chunkData.size() == chunk.size) {
+                unsigned char hash[CHUNK_HASH_SIZE];
+                chunkHash(chunkData.data(), chunkData.size(), hash);
+                if (memcmp(hash, chunk.hash, CHUNK_HASH_SIZE) != 0 ||
+                    !store.put(chunk.hash, chunkData.data(), chunkData.size())) {
+                    return false;
+                }
+                chunkData.clear();
+                ++next;
+            }
+        }
+        return true;
+    });
+    this->waitSequence(false);
+    result = result && !this->m_streamWriteFailed && next == requested.size();
+    this->receiveStream(MessageType::INVALID, nullptr);
+    this->popEndMessage();
+    // Synced once the data was acknowledged, a sync of each chunk in the stream would hold back every window.
+    result = result && (requested.empty() || store.sync());
+    logger->info("Received " + to_string(requested.size()) + " of " + to_string(chunks.size()) +
+                 " chunks, the others were already stored.");
+    if (!result) {
+        return false;
+    }
+
+    // The chunks stored so far stay in the store, so if this fails the next put only sends the rest.
+    string partPath = FileCheckpoint::partPath(filePath);
+    AsyncFileWriter file(partPath);
+    for (const FileChunk& chunk : chunks) {
+        if (!store.get(chunk.hash, chunk.size, data) || !file.write(data.data(), data.size())) {
+            result = false;
+            break;
+        }
+    }
+    result = file.finish() && result;
+    if (result) {
+        result = rename(partPath.c_str(), filePath.c_str()) == 0;
+    }
+    else {
+        remove(partPath.c_str());
+    }
+    return result;
+}
+
+string NetworkNode::handleFileDescriptor(const string &fileWritePath, unsigned long start, unsigned long length,
+                                         bool delta) {
     logger->info("Handling file descriptor.");
     string fileName = this->m_receivedQueue.front().getDataAsString();
     this->m_receivedQueue.pop();
     unsigned long fileSize = this->m_receivedQueue.front().getDataAsUl();
     this->m_receivedQueue.pop();
+    unsigned long flags = 0;
+    if (this->m_receivedQueue.front().getType() == MessageType::FILE_DESCRIPTOR) {
+        flags = this->m_receivedQueue.front().getDataAsUl();
+        this->m_receivedQueue.pop();
+    }
+    delta = delta || (flags & FILE_DESCRIPTOR_DELTA) != 0;
 
-    if (!hasEnoughSpace(fileWritePath, fileSize)) {
-        throw runtime_error("Not enough disk space in ");
+    string filePath = fileWritePath + "/" + fileName;
+    this->m_deltaBasis.clear();
+    this->m_chunkedFile = false;
+    if (delta && fileExists(filePath) && start == 0 && length == numeric_limits<unsigned long>::max()) {
+        // The new copy is written next to the old one, which is only replaced once complete.
+        if (!hasEnoughSpace(fileWritePath, fileSize)) {
+            throw runtime_error("Not enough disk space in ");
+        }
+        this->m_deltaBasis = filePath;
+        this->m_deltaBlockSize = deltaBlockSize(getFileSize(filePath));
+        this->popEndMessage();
+        return fileName;
     }
-    if (fileExists(fileWritePath + "/" + fileName)) {
-        throw runtime_error("File: " + fileName + " already exists in " + fileWritePath + "/" + fileName);
+    if (fileExists(filePath)) {
+        throw runtime_error("File: " + fileName + " already exists in " + filePath);
+    }
+    this->m_checkpoint = FileCheckpoint();
+    this->m_checkpoint.fileSize = fileSize;
+    this->m_checkpoint.start = min(start, fileSize);
+    this->m_checkpoint.length = min(length, fileSize - this->m_checkpoint.start);
+    if ((flags & FILE_DESCRIPTOR_CHUNKS) != 0 && this->m_chunkStore && this->m_checkpoint.length == fileSize) {
+        // The chunks stored by an interrupted transfer make up for its checkpoint.
+        this->m_chunkedFile = true;
+    }
+    else if (this->m_checkpoint.resume(filePath)) {
+        logger->info("Resuming " + filePath + " after " + to_string(this->m_checkpoint.done) + " bytes.");
+    }
+    if (!hasEnoughSpace(fileWritePath, this->m_checkpoint.length - this->m_checkpoint.done)) {
+        throw runtime_error("Not enough disk space in ");
     }
 
     this->popEndMessage();
     return fileName;
 }
 
+void NetworkNode::acceptFile() {
+    if (!this->m_deltaBasis.empty()) {
+        auto signatures = make_shared<SignatureWriter>(this->m_deltaBasis, this->m_deltaBlockSize);
+        this->enqueueStream(MessageType::SIGNATURE, 0, [signatures](char *buffer, size_t size) {
+            return signatures->read(buffer, size);
+        });
+        this->sendSequence();
+        return;
+    }
+    if (this->m_chunkedFile) {
+        this->m_sendQueue.emplace_back(MessageType::CHUNKS, 0);
+        this->m_sendQueue.emplace_back(MessageType::END, 1);
+        this->sendSequence();
+        return;
+    }
+    this->m_sendQueue.emplace_back(MessageType::OK, 0, this->m_checkpoint.start + this->m_checkpoint.done);
+    this->m_sendQueue.emplace_back(MessageType::OK, 1, this->m_checkpoint.length - this->m_checkpoint.done);
+    this->m_sendQueue.emplace_back(MessageType::END, 2);
+    this->sendSequence();
+}
+
+bool NetworkNode::waitFileAccepted(unsigned long &start, unsigned long &length) {
+    // A node that has a copy of the file answers with its signatures instead.
+    vector<C_BYTE> signatures;
+    this->receiveStream(MessageType::SIGNATURE, [&signatures](const C_BYTE *data, size_t size) {
+        signatures.insert(signatures.end(), data, data + size);
+        return true;
+    });
+    this->waitSequence(false);
+    this->receiveStream(MessageType::INVALID, nullptr);
+
+    start = 0;
+    length = numeric_limits<unsigned long>::max();
+    this->m_remoteSignatures.clear();
+    this->m_sendChunks = false;
+    if (!signatures.empty() && this->m_receivedQueue.front().getType() == MessageType::END) {
+        this->m_remoteSignatures = move(signatures);
+        this->popEndMessage();
+        return true;
+    }
+    if (this->m_receivedQueue.front().getType() == MessageType::CHUNKS) {
+        this->m_sendChunks = true;
+        this->m_receivedQueue.pop();
+        this->popEndMessage();
+        return true;
+    }
+    if (this->m_receivedQueue.front().getType() != MessageType::OK) {
+        return this->handleReceivedQueue();
+    }
+
+    // A node without checkpoints accepts with an empty OK, asking for the whole file.
+    if (this->m_receivedQueue.front().getDataSize() > 0) {
+        start = this->m_receivedQueue.front().getDataAsUl();
+    }
+    this->m_receivedQueue.pop();
+    if (this->m_receivedQueue.front().getType() == MessageType::OK) {
+        length = this->m_receivedQueue.front().getDataAsUl();
+        this->m_receivedQueue.pop();
+    }
+    this->popEndMessage();
+    return true;
+}
+
 bool NetworkNode::handleMkdir() {
     this->m_receivedQueue.pop();
     return false;
@@ -312,21 +985,175 @@ bool NetworkNode::handleGET() {
     return false;
 }
 
+bool NetworkNode::handleGlob() {
+    return false;
+}
+
 string NetworkNode::getLongStringMessageData() {
     string result;
+    bool compressed = this->compresses(this->m_receivedQueue.front().getType());
     while (this->m_receivedQueue.front().getType() != MessageType::END) {
-        result += this->m_receivedQueue.front().getDataAsString();
+        const Message& message = this->m_receivedQueue.front();
+        result.append(reinterpret_cast<const char *>(message.getDataBytes()), message.getDataSize());
         this->m_receivedQueue.pop();
     }
+
+    if (compressed) {
+        return StreamDecompressor::decompress(result);
+    }
     return result;
 }
 
-void NetworkNode::enqueueLongStringMessageData(MessageType type, int sequence, const string &text) {
-    vector<Message> messages = Message::fromLongString(type, sequence, text);
+void NetworkNode::enqueueLongStringMessageData(MessageType type, unsigned long sequence, const string &text) {
+    vector<Message> messages = Message::fromLongString(type, sequence,
+                                                       this->compresses(type) ? StreamCompressor::compress(text) : text,
+                                                       this->m_options.maxDataSize());
     this->m_sendQueue.insert(this->m_sendQueue.end(), messages.begin(), messages.end());
     this->m_sendQueue.emplace_back(MessageType::END, messages.back().getSequenceId() + 1);
 }
 
+void NetworkNode::enqueueStream(MessageType type, unsigned long sequence, ChunkReader reader) {
+    if (this->compresses(type)) {
+        auto compressor = make_shared<StreamCompressor>(move(reader));
+        reader = [this, compressor](char *buffer, size_t size) {
+            size_t read = compressor->read(buffer, size);
+            if (read == 0) {
+                logger->info("Compressed " + to_string(compressor->bytesIn()) + " bytes to " +
+                             to_string(compressor->bytesOut()) + ".");
+            }
+            return read;
+        };
+    }
+    this->m_streamReader = move(reader);
+    this->m_streamType = type;
+    this->m_streamSequence = sequence;
+    this->m_streamStarted = false;
+}
+
+bool NetworkNode::enqueueFile(MessageType type, unsigned long sequence, const string &filePath, unsigned long start,
+                              unsigned long length) {
+    if (this->m_sendChunks) {
+        this->m_sendChunks = false;
+        return this->enqueueChunks(sequence, filePath);
+    }
+    if (!this->m_remoteSignatures.empty()) {
+        auto delta = make_shared<DeltaEncoder>(filePath, this->m_remoteSignatures);
+        this->m_remoteSignatures.clear();
+        if (!delta->isOpen()) {
+            return false;
+        }
+        this->enqueueStream(MessageType::DELTA, sequence, [this, delta](char *buffer, size_t size) {
+            size_t read = delta->read(buffer, size);
+            if (read == 0) {
+                logger->info("Delta sent " + to_string(delta->literalBytes()) + " bytes and reused " +
+                             to_string(delta->copiedBytes()) + " bytes of the other copy.");
+            }
+            return read;
+        });
+        return true;
+    }
+
+    // The whole file is asked for with the largest unsigned long, which doesn't fit in an off_t.
+    auto toOffset = [](unsigned long value) {
+        return static_cast<off_t>(min(value, static_cast<unsigned long>(numeric_limits<off_t>::max())));
+    };
+    // The next chunks are read in the background while the window is being sent.
+    auto file = make_shared<AsyncFileReader>(filePath, this->compresses(type) ? COMPRESSION_BLOCK_SIZE
+                                                                              : this->m_options.maxDataSize(),
+                                             toOffset(start), toOffset(length));
+    if (!file->isOpen()) {
+        return false;
+    }
+
+    this->enqueueStream(type, sequence, [file](char *buffer, size_t size) {
+        return file->read(buffer, size);
+    });
+    return true;
+}
+
+bool NetworkNode::enqueueChunks(unsigned long sequence, const string &filePath) {
+    // The other node waits for the list and then for the data even if the file can't be read, an empty list makes it
+    // reject the file.
+    vector<FileChunk> chunks;
+    bool readable = splitFile(filePath, chunks);
+    if (!readable) {
+        chunks.clear();
+    }
+    auto list = make_shared<vector<C_BYTE>>(encodeChunks(chunks));
+    size_t listRead = 0;
+    this->enqueueStream(MessageType::CHUNKS, 0, [list, listRead](char *buffer, size_t size) mutable {
+        size_t count = min(size, list->size() - listRead);
+        memcpy(buffer, list->data() + listRead, count);
+        listRead += count;
+        return count;
+    });
+    this->sendSequence();
+
+    vector<C_BYTE> missing;
+    this->receiveStream(MessageType::CHUNKS, [&missing](const C_BYTE *data, size_t size) {
+        missing.insert(missing.end(), data, data + size);
+        return true;
+    });
+    this->waitSequence(false);
+    this->receiveStream(MessageType::INVALID, nullptr);
+    this->popEndMessage();
+
+    vector<FileChunk> requested;
+    size_t requestedBytes = 0;
+    for (size_t i = 0; i < chunks.size() && i / 8 < missing.size(); ++i) {
+        if (missing[i / 8] & (1 << (i % 8))) {
+            requested.push_back(chunks[i]);
+            requestedBytes += chunks[i].size;
+        }
+    }
+    logger->info("Sending " + to_string(requested.size()) + " of " + to_string(chunks.size()) + " chunks (" +
+                 to_string(requestedBytes) + " bytes), the others are already stored by the other node.");
+
+    auto file = make_shared<FileChunkReader>(filePath, move(requested));
+    if (!readable || !file->isOpen()) {
+        return false;
+    }
+    this->enqueueStream(MessageType::FILE_DATA, sequence, [file](char *buffer, size_t size) {
+        return file->read(buffer, size);
+    });
+    return true;
+}
+
+void NetworkNode::receiveStream(MessageType type, ChunkWriter writer) {
+    if (writer && this->compresses(type)) {
+        auto decompressor = make_shared<StreamDecompressor>(move(writer));
+        writer = [decompressor](const C_BYTE *data, size_t size) {
+            return decompressor->write(data, size);
+        };
+    }
+    this->m_streamWriter = move(writer);
+    this->m_streamWriterType = type;
+    this->m_streamWriteFailed = false;
+}
+
+bool NetworkNode::compresses(MessageType type) const {
+    return this->m_options.compression &&
+           (type == MessageType::FILE_DATA || type == MessageType::DELTA || type == MessageType::LS_SHOW);
+}
+
+void NetworkNode::fillSendQueue(size_t count) {
+    while (this->m_streamReader && this->m_sendQueue.size() < count) {
+        this->m_streamBuffer.resize(this->m_options.maxDataSize());
+        size_t read = this->m_streamReader(this->m_streamBuffer.data(), this->m_streamBuffer.size());
+
+        // Like enqueueLongStringMessageData, empty data is still sent as a single empty message.
+        if (read > 0 || !this->m_streamStarted) {
+            auto data = reinterpret_cast<const C_BYTE *>(this->m_streamBuffer.data());
+            this->m_sendQueue.emplace_back(this->m_streamType, this->m_streamSequence++, data, read);
+            this->m_streamStarted = true;
+        }
+        if (read == 0) {
+            this->m_sendQueue.emplace_back(MessageType::END, this->m_streamSequence);
+            this->m_streamReader = nullptr;
+        }
+    }
+}
+
 void NetworkNode::popEndMessage() {
     if (!this->m_receivedQueue.empty() && this->m_receivedQueue.front().getType() == MessageType::END) {
         // Remove the end from the queue.
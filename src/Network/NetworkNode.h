@@ -1,16 +1,43 @@
 #ifndef REDES_1_T1_NETWORKNODE_H
 #define REDES_1_T1_NETWORKNODE_H
 
+#include <deque>
 #include <queue>
 #include <memory>
+#include <functional>
+#include <limits>
 #include "../Message/Message.h"
 #include "../Logger/Logger.h"
+#include "../FileHandler/FileCheckpoint.h"
+#include "EventLoop.h"
+#include "LinkOptions.h"
+#include "RttEstimator.h"
+#include "SlidingWindow.h"
+#include "Transport.h"
+
+class ChunkStore;
 
 // #define DEVICE "lo"
 #define DEVICE "enp5s0"
+/// \brief Transport used when none is given in the command line.
+#define DEFAULT_TRANSPORT "raw:" DEVICE
 
-#define WINDOW_SIZE 4
-#define TIMEOUT 5000
+/// \brief Bytes at the start of a SACK holding the next expected sequence id, followed by the bitmap.
+#define SACK_BASE_SIZE static_cast<size_t>(4)
+/// \brief Most frames taken from the transport at once, limits the receive buffers when frames and windows are large.
+#define RECEIVE_BATCH_SIZE 64
+/// \brief Receive timeout of a transport whose descriptor is watched by the event loop, in milliseconds. It is only
+/// reached if the descriptor was readable but the frame was dropped before being received (e.g. bad UDP checksum).
+#define EVENT_RECEIVE_TIMEOUT 1
+/// \brief How long a transport without a descriptor waits for frames when there is no deadline, in milliseconds.
+#define IDLE_RECEIVE_TIMEOUT 1000
+/// \brief Flag of the optional third FILE_DESCRIPTOR, asking the receiver to update its copy of the file with a delta.
+#define FILE_DESCRIPTOR_DELTA 1ul
+/// \brief Flag of the optional third FILE_DESCRIPTOR, offering to send the file as chunks, of which a receiver with a
+/// ChunkStore only asks for the ones it doesn't have.
+#define FILE_DESCRIPTOR_CHUNKS 2ul
+/// \brief Suffix of the file a delta is written to, renamed over the old copy once verified.
+#define DELTA_FILE_SUFFIX ".delta"
 
 /**
  * @brief Abstract class representing a node in the network.
@@ -18,6 +45,8 @@
 class NetworkNode {
 public:
     explicit NetworkNode();
+    /// \brief Create a node that talks to the other node through the given transport.
+    explicit NetworkNode(unique_ptr<Transport> transport);
     virtual ~NetworkNode() = default;
 
     /**
@@ -27,18 +56,46 @@ public:
      */
     bool waitSequence(bool handleReceived = true);
 
+    /**
+     * @brief Propose link options to the other node, which answers with the ones it accepted. Both nodes switch to
+     * the accepted options once the answer is received.
+     * @return true if the other node accepted a set of options, false if it answered with an error.
+     */
+    bool negotiate(const LinkOptions& proposal);
+    /// \brief Use the given options right away, without asking the other node (which must use the same ones).
+    void setLinkOptions(const LinkOptions& options);
+    const LinkOptions& getLinkOptions() const { return m_options; }
+    /// \brief Round trip time of the link measured so far.
+    const RttEstimator& getRttEstimator() const { return m_rtt; }
+    /// \brief Keep the chunks of the files received in store, and take from it the ones a new file shares with them.
+    /// nullptr to receive whole files.
+    void setChunkStore(shared_ptr<ChunkStore> store) { m_chunkStore = move(store); }
+
     /// \brief Sequence of bits that represents the start of a new message.
     static unsigned char message_delimiter;
+    /// \brief true if the transport also receives the frames we send, so the delimiter must be inverted when sending.
+    /// Like message_delimiter, set once by main before any node is created, since nodes of other threads read it.
+    static bool echo_transport;
 
 protected:
     /// \brief Queue storing the received messages in the correct order.
     queue<Message> m_receivedQueue;
     /// \brief Queue of messages to be sent to another node.
-    vector<Message> m_sendQueue;
+    deque<Message> m_sendQueue;
+    /// \brief Progress of the file being received, set by handleFileDescriptor.
+    FileCheckpoint m_checkpoint;
+
+    /// \brief Reads up to size bytes of the data of a streamed sequence into buffer.
+    /// \return The number of bytes read, 0 once there is no more data.
+    typedef function<size_t(char *buffer, size_t size)> ChunkReader;
+    /// \brief Consumes the data of a received message of a streamed sequence, in order.
+    /// \return false if the data couldn't be stored.
+    typedef function<bool(const C_BYTE *data, size_t size)> ChunkWriter;
 
     /**
      * @brief Get the data from multiple messages as a single string (of the same command, until MessageType::END).
      * @return Returns the string containing the data.
+     * @throw runtime_error if the data was compressed and can't be decompressed, the END is left in the queue.
      */
     string getLongStringMessageData();
     /**
@@ -48,7 +105,33 @@ protected:
      * @param sequence The start sequence of the message.
      * @param text The data field of the message.
      */
-    void enqueueLongStringMessageData(MessageType type, int sequence, const string& text);
+    void enqueueLongStringMessageData(MessageType type, unsigned long sequence, const string& text);
+    /**
+     * @brief Enqueue a message sequence whose data is read from reader only when the sliding window needs it, so the
+     * memory used doesn't depend on the size of the data. It also appends the END of the message.
+     * Must be the last sequence enqueued before sendSequence.
+     * @param type The type of the messages to be enqueued.
+     * @param sequence The start sequence of the message.
+     * @param reader Called with buffers of the size of the data of a message, or of COMPRESSION_BLOCK_SIZE if the
+     * sequence is compressed.
+     */
+    void enqueueStream(MessageType type, unsigned long sequence, ChunkReader reader);
+    /// \brief Enqueue the content of a file as a streamed sequence, see enqueueStream. If the other node answered
+    /// waitFileAccepted with the signatures of its copy, a DELTA sequence is enqueued instead of the type given. If it
+    /// asked for chunks, the list of chunks is sent first and only the data of the ones it is missing is enqueued.
+    /// \param start, length Only send the length bytes starting at start (or until the end of the file).
+    /// \return false if the file can't be opened.
+    bool enqueueFile(MessageType type, unsigned long sequence, const string& filePath, unsigned long start = 0,
+                     unsigned long length = numeric_limits<unsigned long>::max());
+    /**
+     * @brief Pass the data of the next received messages of the given type to writer as soon as they are accepted,
+     * instead of storing them in the received queue. Other messages, including the END, are queued as usual.
+     * @param type The type of the streamed messages.
+     * @param writer Called once for each message, in order. nullptr stops streaming.
+     */
+    void receiveStream(MessageType type, ChunkWriter writer);
+    /// \brief true if the data of the sequences of the given type is deflated, see LinkOptions::compression.
+    bool compresses(MessageType type) const;
 
     /**
      * @brief Receives a sequence of messages, enqueueing it in the approiate order, while also sendiing ACKs and NACKs
@@ -63,6 +146,9 @@ protected:
     /// \brief Remove the END message from the queue to prepare for a new sequence.
     void popEndMessage();
 
+    /// \brief Handle the link options proposed by the other node, answering with the ones accepted.
+    /// \return true if the execution was successfull, false otherwise.
+    virtual bool handleNegotiate();
     /// \brief Handle a 'ls' command message.
     /// \return true if the execution was successfull, false otherwise.
     virtual bool handleLS();
@@ -87,24 +173,95 @@ protected:
     /// \brief Handle a 'get' command message.
     /// \return true if the execution was successfull, false otherwise.
     virtual bool handleGET();
+    /// \brief Handle a 'glob' message, listing the files that match the given patterns.
+    /// \return true if the execution was successfull, false otherwise.
+    virtual bool handleGlob();
 
     /// \brief Handle a message containing a file, writing the file in the disk as specified by the message containing
     /// its descriptor.
-    /// \return true if the execution was successfull, false otherwise.
+    /// \return true if the whole file (or slice) was received, false otherwise.
+    /// Waits for the data itself, writing each window to the disk as it is accepted. The data goes to a part file
+    /// with a checkpoint every CHECKPOINT_INTERVAL bytes, renamed to filePath once complete. A delta is applied to a
+    /// new copy instead, which replaces the old one only if it has the MD5 the sender computed. A file sent as chunks
+    /// is rebuilt from the chunk store, after storing the chunks it didn't have.
     virtual bool handleFileData(const string& filePath);
     /// \brief Handle a message containing the description of a file to be written, verifying if the path is valid and
-    /// if we have enough disk space to write it.
-    /// \return true if the execution was successfull, false otherwise.
-    virtual string handleFileDescriptor(const string& fileWritePath);
+    /// if we have enough disk space to write it, and looking for the checkpoint of a previous transfer to resume.
+    /// \param start, length Only receive the length bytes of the file starting at start.
+    /// \param delta Update the file with a delta if it already exists, also asked for by the other node with a
+    /// FILE_DESCRIPTOR_DELTA descriptor. Ignored for a range.
+    /// \return The name of the file.
+    virtual string handleFileDescriptor(const string& fileWritePath, unsigned long start = 0,
+                                        unsigned long length = numeric_limits<unsigned long>::max(),
+                                        bool delta = false);
+    /// \brief Accept the file of the last descriptor, asking the other node for the data the checkpoint is missing, for
+    /// a delta by sending the signatures of the existing file, or for its list of chunks.
+    void acceptFile();
+    /// \brief Wait for the other node to accept a file described to it.
+    /// \param start, length Set to the range of the file to send.
+    /// \return false if the other node refused the file.
+    bool waitFileAccepted(unsigned long& start, unsigned long& length);
 
     /// \brief Stores a pointer to a logger object.
     Logger *logger;
 
-private:
-    int m_socket;
-
     /// \brief Stores the received message unordered, exactly in the way it was received.
     vector<Message> m_receivedBuffer;
+    /// \brief Walk through the buffer ordering the messages and verifying if we got all the messages needed in a sequence.
+    /// The accepted messages are kept in m_acceptedWindow.
+    /// \param startSeq the start of the sequence we are handling.
+    /// \return The next expected message id.
+    unsigned long handleReceivedBuffer(unsigned long startSeq);
+
+private:
+    unique_ptr<Transport> m_transport;
+    /// \brief Frames of the window being sent, reused between windows.
+    FrameBatch m_sendBatch;
+    /// \brief Frame of a single message sent by sendMessage, reused between messages.
+    vector<C_BYTE> m_frameBuffer;
+
+    /// \brief Sequence being streamed by enqueueStream, its messages are created by fillSendQueue.
+    ChunkReader m_streamReader;
+    MessageType m_streamType = MessageType::INVALID;
+    unsigned long m_streamSequence = 0;
+    bool m_streamStarted = false;
+    vector<char> m_streamBuffer;
+    /// \brief Sequence being received by receiveStream.
+    ChunkWriter m_streamWriter;
+    MessageType m_streamWriterType = MessageType::INVALID;
+    bool m_streamWriteFailed = false;
+
+    /// \brief Existing file the last descriptor is applied to as a delta, empty for a normal transfer, and the block size
+    /// of its signatures.
+    string m_deltaBasis;
+    size_t m_deltaBlockSize = 0;
+    /// \brief Signatures received by waitFileAccepted, the next enqueueFile sends a delta against them.
+    vector<C_BYTE> m_remoteSignatures;
+    /// \brief Chunks of the received files, nullptr if they are received whole.
+    shared_ptr<ChunkStore> m_chunkStore;
+    /// \brief true if the file of the last descriptor is received as chunks.
+    bool m_chunkedFile = false;
+    /// \brief true if the other node asked for the chunks of the file described to it.
+    bool m_sendChunks = false;
+
+    LinkOptions m_options;
+    /// \brief Round trip time of the link, shared by sending and receiving, since both use the same link.
+    RttEstimator m_rtt;
+    /// \brief Receive timeout currently set in the transport, in milliseconds.
+    long m_receiveTimeout = -1;
+    /// \brief Sleeps on the descriptor of the transport and the retransmission timers, nullptr if the transport has
+    /// no descriptor, in which case its receive timeout is set to the next deadline instead.
+    unique_ptr<EventLoop> m_events;
+
+    /// \brief Last window of the previous sequence received and the SACK (or ACK with go-back-N) that accepted it.
+    /// If the SACK is lost the other node sends this window again, and it must be acknowledged again instead of being
+    /// taken as the start of a new sequence. Forgotten once we send a sequence of our own.
+    SlidingWindow<Message> m_previousWindow;
+    unique_ptr<Message> m_previousSack;
+    /// \brief Last window of the sequence being received, becomes m_previousWindow once the sequence ends.
+    SlidingWindow<Message> m_acceptedWindow;
+    /// \brief Messages received after the next expected one, indexed by their distance to it.
+    SlidingWindow<Message> m_reorderWindow;
 
     /// \brief Points to the last message we received to avoid duplicates.
     unique_ptr<Message> lastMessageReceived;
@@ -114,13 +271,51 @@ private:
      * @return true if the execution was successfull, false otherwise.
      */
     bool handleReceivedQueue();
-    /// \brief Receive a single message, storing on the message buffer and ignoring duplicates, noise and corrupted messages.
-    /// \return true if we received a valid, non duplicate, non corrupted message.
-    bool receiveMessage();
-    /// \brief Walk through the buffer ordering the messages and verifying if we got all the messages needed in a sequence.
-    /// \param startSeq the start of the sequence we are handling.
-    /// \return The next expected message id.
-    unsigned long handleReceivedBuffer(unsigned long startSeq);
+    /// \brief Receive every pending message (at least one, up to a window), storing them on the message buffer.
+    /// \param deadline Give up once it passes (the next timer of the protocol), time_point::max() to wait for as long
+    /// as it takes.
+    /// \return true if we received at least one valid, non duplicate, non corrupted message.
+    bool receiveMessages(chrono::steady_clock::time_point deadline);
+    /// \brief Decode a single received frame, storing it on the message buffer and ignoring duplicates, noise and
+    /// corrupted messages.
+    /// \return true if the frame was a valid, non duplicate, non corrupted message.
+    bool handleReceivedFrame(const C_BYTE *data, size_t bytesReceived);
+    /// \brief Create the next messages of the streamed sequence until the send queue holds count messages or the
+    /// stream ends.
+    void fillSendQueue(size_t count);
+    /// \brief Go-back-N version of sendSequence.
+    bool sendSequenceGoBackN();
+    /// \brief Go-back-N version of receiveSequence.
+    bool receiveSequenceGoBackN();
+    /// \brief Selective repeat version of sendSequence: each message has its own timer, and only the messages not
+    /// acknowledged by a SACK are sent again.
+    bool sendSequenceSelectiveRepeat();
+    /// \brief Selective repeat version of receiveSequence: out of order messages are kept until the missing ones arrive.
+    bool receiveSequenceSelectiveRepeat();
+    /// \brief Send a SACK accepting every message before nextSeq, plus the ones marked in the reorder window.
+    /// \param nextSeq the first message we are still missing.
+    /// \param reorderWindow messages already received after nextSeq, indexed by their distance to nextSeq.
+    Message sendSack(unsigned long nextSeq, const SlidingWindow<Message>& reorderWindow);
+    /// \brief true if the message belongs to the previous sequence, in which case its SACK (or ACK) is sent again.
+    bool acknowledgePreviousWindow(const Message& message);
+    /// \brief Read the first message not accepted yet by an ACK, NACK or SACK, so each ARQ mode understands the answers
+    /// of the other one: a node switches back to the defaults to negotiate with a new client, whose answers may still
+    /// come in the mode of the previous one.
+    /// \return false if the message is not an answer.
+    bool acknowledgedSequence(const Message& message, unsigned long& nextSeq) const;
+
+    /// \brief Number of messages from the sequence id from to the sequence id to, wrapping around the sequence space.
+    unsigned long sequenceDistance(unsigned long from, unsigned long to) const;
+
+    /// \brief Receive the delta of the file of the last descriptor, see handleFileData.
+    bool receiveDelta(const string& filePath);
+    /// \brief Receive the file of the last descriptor as chunks, see handleFileData.
+    bool receiveChunks(const string& filePath);
+    /// \brief Send the list of chunks of a file and enqueue the data of the ones the other node asks for.
+    /// \return false if the file can't be read.
+    bool enqueueChunks(unsigned long sequence, const string& filePath);
+    /// \brief Deliver an in order message, to the stream writer or to the received queue.
+    void acceptMessage(const Message& message);
     /// \brief Send a single message to the connected socket.
     /// \param message the message to be sent.
     /// \return true if the message was sent correctly.
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "PacketMmapTransport.h"
+#include "ConexaoRawSocket.h"
+#include "RawSocketIncludes.h"
+
+/// \brief Where the frame data starts inside a transmit slot (PACKET_TX_HAS_OFF isn't used).
+#define TX_DATA_OFFSET (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+PacketMmapTransport::PacketMmapTransport(int socket, bool echoesOwnFrames, size_t maxFrameSize) :
+        SocketTransport(socket, echoesOwnFrames, maxFrameSize) {
+    // Transmit slots must hold the largest frame (jumbo frames need more than the default), and be a power of two
+    // that divides the block size.
+    while (this->m_ringFrameSize < maxFrameSize + TX_DATA_OFFSET) {
+        this->m_ringFrameSize *= 2;
+    }
+    this->m_ringBlockSize = max(this->m_ringBlockSize, this->m_ringFrameSize);
+    this->m_txFrameCount = (this->m_ringBlockSize / this->m_ringFrameSize) * RING_BLOCK_COUNT;
+
+    int version = TPACKET_V3;
+    if (setsockopt(this->m_socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+        throw runtime_error("Could not set TPACKET_V3 in the raw socket.");
+    }
+
+    struct tpacket_req3 request;
+    memset(&request, 0, sizeof(request));
+    request.tp_block_size = this->m_ringBlockSize;
+    request.tp_block_nr = RING_BLOCK_COUNT;
+    request.tp_frame_size = this->m_ringFrameSize;
+    request.tp_frame_nr = this->m_txFrameCount;
+
+    // The kernel refuses transmit rings with a block timeout, so it is only set for the receive ring.
+    if (setsockopt(this->m_socket, SOL_PACKET, PACKET_TX_RING, &request, sizeof(request)) == -1) {
+        throw runtime_error("Could not create the PACKET_MMAP transmit ring.");
+    }
+    request.tp_retire_blk_tov = RING_BLOCK_TIMEOUT;
+    if (setsockopt(this->m_socket, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) == -1) {
+        throw runtime_error("Could not create the PACKET_MMAP receive ring.");
+    }
+
+    // Both rings are mapped at once, the receive ring comes first.
+    this->m_ringSize = 2 * static_cast<size_t>(this->m_ringBlockSize) * RING_BLOCK_COUNT;
+    void *ring = mmap(nullptr, this->m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, this->m_socket, 0);
+    if (ring == MAP_FAILED) {
+        ring = mmap(nullptr, this->m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, this->m_socket, 0);
+    }
+    if (ring == MAP_FAILED) {
+        throw runtime_error("Could not map the PACKET_MMAP rings.");
+    }
+    this->m_ring = static_cast<C_BYTE *>(ring);
+}
+
+PacketMmapTransport::~PacketMmapTransport() {
+    if (this->m_ring != nullptr) {
+        munmap(this->m_ring, this->m_ringSize);
+    }
+}
+
+unique_ptr<PacketMmapTransport> PacketMmapTransport::open(const string &device) {
+    int socket = ConexaoRawSocket(device.c_str());
+    try {
+        return unique_ptr<PacketMmapTransport>(new PacketMmapTransport(socket, device == "lo",
+                                                                       deviceFrameSize(socket, device)));
+    }
+    catch (runtime_error&) {
+        close(socket);
+        throw;
+    }
+}
+
+bool PacketMmapTransport::queueFrame(const C_BYTE *frame, size_t size) {
+    if (size > this->m_ringFrameSize - TX_DATA_OFFSET) {
+        return false;
+    }
+
+    C_BYTE *slot = this->m_ring + static_cast<size_t>(this->m_ringBlockSize) * RING_BLOCK_COUNT +
+                   static_cast<size_t>(this->m_txFrame) * this->m_ringFrameSize;
+    auto header = reinterpret_cast<struct tpacket3_hdr *>(slot);
+
+    // The slot is still owned by the kernel, send what is queued and wait for it to be released.
+    while (__atomic_load_n(&header->tp_status, __ATOMIC_ACQUIRE) & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) {
+        this->flush();
+        struct pollfd pfd = {this->m_socket, POLLOUT, 0};
+        poll(&pfd, 1, 1);
+    }
+
+    memcpy(slot + TX_DATA_OFFSET, frame, size);
+    header->tp_len = static_cast<__u32>(size);
+    header->tp_next_offset = 0;
+    __atomic_store_n(&header->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    this->m_txFrame = (this->m_txFrame + 1) % this->m_txFrameCount;
+    return true;
+}
+
+bool PacketMmapTransport::flush() {
+    return send(this->m_socket, nullptr, 0, 0) != -1;
+}
+
+long PacketMmapTransport::sendFrame(const C_BYTE *frame, size_t size) {
+    if (!this->queueFrame(frame, size) || !this->flush()) {
+        return -1;
+    }
+    return static_cast<long>(size);
+}
+
+size_t PacketMmapTransport::sendBatch(const FrameBatch &batch) {
+    size_t queued = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (this->queueFrame(batch.frame(i), batch.frameSize(i))) {
+            queued++;
+        }
+    }
+    return this->flush() ? queued : 0;
+}
+
+size_t PacketMmapTransport::receiveBatch(const FrameHandler &handler, size_t maxFrames) {
+    size_t handled = 0;
+    bool waited = false;
+
+    while (handled < maxFrames) {
+        auto block = reinterpret_cast<struct tpacket_block_desc *>(
+                this->m_ring + static_cast<size_t>(this->m_rxBlock) * this->m_ringBlockSize);
+
+        if (this->m_rxBlockFramesLeft == 0) {
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+                // Only wait if we didn't get anything yet, otherwise return what we have.
+                if (handled > 0 || waited) {
+                    break;
+                }
+                struct pollfd pfd = {this->m_socket, POLLIN | POLLERR, 0};
+                waited = true;
+                if (poll(&pfd, 1, static_cast<int>(this->m_receiveTimeout)) <= 0) {
+                    break;
+                }
+                continue;
+            }
+
+            this->m_rxBlockFramesLeft = block->hdr.bh1.num_pkts;
+            this->m_rxNextFrame = reinterpret_cast<C_BYTE *>(block) + block->hdr.bh1.offset_to_first_pkt;
+        }
+
+        if (this->m_rxBlockFramesLeft > 0) {
+            auto header = reinterpret_cast<struct tpacket3_hdr *>(this->m_rxNextFrame);
+            handler(this->m_rxNextFrame + header->tp_mac, header->tp_snaplen);
+            handled++;
+            this->m_rxBlockFramesLeft--;
+            this->m_rxNextFrame += header->tp_next_offset;
+        }
+
+        // Every frame of the block was read, give it back to the kernel.
+        if (this->m_rxBlockFramesLeft == 0) {
+            __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            this->m_rxBlock = (this->m_rxBlock + 1) % RING_BLOCK_COUNT;
+        }
+    }
+
+    return handled;
+}
+
+long PacketMmapTransport::receiveFrame(C_BYTE *buffer, size_t size) {
+    long copied = -1;
+    this->receiveBatch([&](const C_BYTE *frame, size_t frameSize) {
+        copied = static_cast<long>(min(size, frameSize));
+        memcpy(buffer, frame, static_cast<size_t>(copied));
+    }, 1);
+    return copied;
+}
@@ -0,0 +1,61 @@
+#ifndef REDES_1_T1_PACKETMMAPTRANSPORT_H
+#define REDES_1_T1_PACKETMMAPTRANSPORT_H
+
+#include "Transport.h"
+
+/// \brief Minimum size of the ring blocks and transmit slots, both grow for devices with a larger MTU.
+#define RING_BLOCK_SIZE (1u << 16)
+#define RING_BLOCK_COUNT 64u
+#define RING_FRAME_SIZE (1u << 11)
+/// \brief How long the kernel waits before handing a partially filled receive block to us, in milliseconds.
+#define RING_BLOCK_TIMEOUT 1
+
+/**
+ * @brief Raw socket transport that exchanges frames through receive and transmit rings shared with the kernel
+ * (PACKET_MMAP, TPACKET_V3).
+ *
+ * Received frames are handed to the caller directly from the ring, without being copied to a buffer by recv, and a
+ * whole batch of frames is written to the transmit ring and flushed with a single send call.
+ */
+class PacketMmapTransport: public SocketTransport {
+public:
+    ~PacketMmapTransport() override;
+
+    long sendFrame(const C_BYTE *frame, size_t size) override;
+    long receiveFrame(C_BYTE *buffer, size_t size) override;
+    void setReceiveTimeout(long milliseconds) override { m_receiveTimeout = milliseconds; }
+
+    size_t sendBatch(const FrameBatch& batch) override;
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames) override;
+    /// \brief true if receiveBatch stopped in the middle of a block, whose frames don't make the socket readable.
+    bool hasPendingFrames() const override { return m_rxBlockFramesLeft > 0; }
+
+    /// \brief Open a raw socket on a network device and map its receive and transmit rings.
+    static unique_ptr<PacketMmapTransport> open(const string& device);
+
+private:
+    PacketMmapTransport(int socket, bool echoesOwnFrames, size_t maxFrameSize);
+
+    C_BYTE *m_ring = nullptr;
+    size_t m_ringSize = 0;
+    unsigned int m_ringBlockSize = RING_BLOCK_SIZE;
+    unsigned int m_ringFrameSize = RING_FRAME_SIZE;
+    unsigned int m_txFrameCount = 0;
+    long m_receiveTimeout = -1;
+
+    /// \brief Receive block currently being read, and the position of the next frame inside it.
+    unsigned int m_rxBlock = 0;
+    unsigned int m_rxBlockFramesLeft = 0;
+    C_BYTE *m_rxNextFrame = nullptr;
+
+    /// \brief Next transmit slot to be filled.
+    unsigned int m_txFrame = 0;
+
+    /// \brief Copy a frame to the next free transmit slot, without asking the kernel to send it.
+    bool queueFrame(const C_BYTE *frame, size_t size);
+    /// \brief Ask the kernel to send every queued frame.
+    bool flush();
+};
+
+
+#endif //REDES_1_T1_PACKETMMAPTRANSPORT_H
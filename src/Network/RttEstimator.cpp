@@ -0,0 +1,24 @@
+#include <algorithm>
+#include "RttEstimator.h"
+
+void RttEstimator::addSample(chrono::microseconds rtt) {
+    long sample = max(static_cast<long>(rtt.count()), 1l);
+
+    if (!this->m_hasSample) {
+        this->m_smoothedRtt = sample;
+        this->m_rttVariation = sample / 2;
+        this->m_hasSample = true;
+    }
+    else {
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R.
+        this->m_rttVariation = (3 * this->m_rttVariation + abs(this->m_smoothedRtt - sample)) / 4;
+        this->m_smoothedRtt = (7 * this->m_smoothedRtt + sample) / 8;
+    }
+
+    this->m_timeout = min(max(this->m_smoothedRtt + 4 * this->m_rttVariation, static_cast<long>(MIN_RETRANSMIT_TIMEOUT)),
+                          static_cast<long>(MAX_RETRANSMIT_TIMEOUT));
+}
+
+void RttEstimator::backoff() {
+    this->m_timeout = min(2 * this->m_timeout, static_cast<long>(MAX_RETRANSMIT_TIMEOUT));
+}
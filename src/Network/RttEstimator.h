@@ -0,0 +1,40 @@
+#ifndef REDES_1_T1_RTTESTIMATOR_H
+#define REDES_1_T1_RTTESTIMATOR_H
+
+#include <chrono>
+
+using namespace std;
+
+/// \brief Retransmission timeout used before the first round trip is measured, in microseconds.
+#define INITIAL_RETRANSMIT_TIMEOUT 1000000
+/// \brief Bounds of the retransmission timeout, in microseconds.
+#define MIN_RETRANSMIT_TIMEOUT 1000
+#define MAX_RETRANSMIT_TIMEOUT 5000000
+
+/**
+ * @brief Estimates the round trip time of the link from measured samples (SRTT/RTTVAR, as in RFC 6298) and derives
+ * the retransmission timeout from it.
+ *
+ * Samples must only be taken from messages that were sent a single time (Karn's rule), since the acknowledgement of
+ * a retransmitted message can't be matched to one of its transmissions.
+ */
+class RttEstimator {
+public:
+    /// \brief Add a round trip time measurement, which also cancels any backoff.
+    void addSample(chrono::microseconds rtt);
+    /// \brief Double the timeout after a retransmission timeout, up to MAX_RETRANSMIT_TIMEOUT.
+    void backoff();
+
+    /// \brief How long to wait for an acknowledgement before sending a message again.
+    chrono::microseconds timeout() const { return chrono::microseconds(m_timeout); }
+    chrono::microseconds smoothedRtt() const { return chrono::microseconds(m_smoothedRtt); }
+
+private:
+    bool m_hasSample = false;
+    long m_smoothedRtt = 0;
+    long m_rttVariation = 0;
+    long m_timeout = INITIAL_RETRANSMIT_TIMEOUT;
+};
+
+
+#endif //REDES_1_T1_RTTESTIMATOR_H
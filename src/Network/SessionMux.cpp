@@ -0,0 +1,30 @@
+#include "SessionMux.h"
+
+MuxSession::MuxSession(SessionMux &mux, uint32_t id, const PeerAddress &peer, bool accepted) :
+        MuxEndpoint(mux, id, peer, accepted, SESSION_QUEUE_SIZE) {}
+
+void MuxSession::throwClosed() const {
+    throw SessionExpired("Session " + to_string(this->m_id) + " expired.");
+}
+
+SessionMux::SessionMux(unique_ptr<Transport> transport) :
+        Multiplexer(move(transport), SESSION_DELIMITER, SESSION_ID_SIZE, MAX_SESSIONS, SESSION_IDLE_TIMEOUT) {
+    this->start();
+}
+
+SessionMux::~SessionMux() {
+    this->stop();
+}
+
+MuxEndpoint *SessionMux::newEndpoint(uint32_t id, const PeerAddress &peer, bool accepted) {
+    return new MuxSession(*this, id, peer, accepted);
+}
+
+bool SessionMux::admit(MuxEndpoint *endpoint, const C_BYTE *, size_t, const PeerAddress &peer) {
+    if (endpoint != nullptr && endpoint->peer() != peer) {
+        // Another client using the same id.
+        this->m_dropped++;
+        return false;
+    }
+    return true;
+}
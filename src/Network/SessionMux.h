@@ -0,0 +1,80 @@
+#ifndef REDES_1_T1_SESSIONMUX_H
+#define REDES_1_T1_SESSIONMUX_H
+
+#include <stdexcept>
+#include "Multiplexer.h"
+
+/// \brief Bytes of the session id, sent after SESSION_DELIMITER in front of each frame of a link shared by several
+/// clients.
+#define SESSION_ID_SIZE 4
+/// \brief Starts every frame of a shared link. Differs from the message delimiters (normal, extended and inverted) and
+/// from CHANNEL_DELIMITER, so frames of a node that doesn't use sessions are dropped.
+#define SESSION_DELIMITER 0b01010011
+/// \brief Sessions served at once, frames of new sessions are dropped until one of them expires.
+#define MAX_SESSIONS 256
+/// \brief Frames held by the queue of each session, enough for the largest window of the extended header.
+#define SESSION_QUEUE_SIZE 4096
+/// \brief A session accepted from a client that sends nothing for this long (in seconds) is closed, its client is
+/// considered gone since clients don't say when they stop. A client that comes back later gets a new session, with
+/// the default link options and directory, so it must be restarted.
+#define SESSION_IDLE_TIMEOUT 3600
+
+class SessionMux;
+
+/// \brief Thrown by the receive methods of an accepted session once it expired, stopping the node that serves it.
+class SessionExpired: public runtime_error {
+    using runtime_error::runtime_error;
+};
+
+/**
+ * @brief One of the sessions of a shared link, seen by the node using it as a transport of its own: it only receives
+ * the frames of its session, and only from the node that opened it.
+ *
+ * Its receive methods throw SessionExpired once it expired.
+ */
+class MuxSession: public MuxEndpoint {
+public:
+    uint32_t id() const { return m_id; }
+
+private:
+    friend class SessionMux;
+    MuxSession(SessionMux& mux, uint32_t id, const PeerAddress& peer, bool accepted);
+
+    void throwClosed() const override;
+};
+
+/**
+ * @brief Shares a single link between the sessions of several clients, so a single server serves all of them at once,
+ * each with a node (and usually a thread) of its own: its own sliding window, sequence ids, timers, received messages
+ * and current directory.
+ *
+ * Every frame starts with SESSION_DELIMITER and the id of its session, chosen by the client. A session is identified
+ * by its id and the address of the client (its UDP port, see PeerAddress), so a client can't take over a session of
+ * another one by reusing its id. The clients must use sessions too.
+ */
+class SessionMux: public Multiplexer {
+public:
+    /// \brief Called by the receiving thread of the mux with a session opened by a client, and its id. Must return
+    /// quickly, frames of every session wait for it.
+    typedef Acceptor SessionAcceptor;
+
+    /// \param transport The link shared by the sessions, only used by the mux from now on.
+    explicit SessionMux(unique_ptr<Transport> transport);
+    /// \brief Stop the receiving thread. Every session must be closed before.
+    ~SessionMux() override;
+
+    /// \brief Open the session with the given id, with the other node of the link (a client opens its session).
+    /// \return nullptr if the session is already open.
+    unique_ptr<Transport> open(uint32_t id) { return Multiplexer::open(id); }
+    /// \brief Open a session for each id that receives a frame while no session uses it (up to MAX_SESSIONS), and
+    /// hand it to acceptor with that frame already queued. Without an acceptor those frames are dropped.
+    void accept(SessionAcceptor acceptor) { Multiplexer::accept(move(acceptor)); }
+
+protected:
+    MuxEndpoint *newEndpoint(uint32_t id, const PeerAddress& peer, bool accepted) override;
+    /// \brief Drops the frames of a session sent by another client using the same id.
+    bool admit(MuxEndpoint *endpoint, const C_BYTE *frame, size_t size, const PeerAddress& peer) override;
+};
+
+
+#endif //REDES_1_T1_SESSIONMUX_H
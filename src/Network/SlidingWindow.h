@@ -0,0 +1,82 @@
+#ifndef REDES_1_T1_SLIDINGWINDOW_H
+#define REDES_1_T1_SLIDINGWINDOW_H
+
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief Fixed capacity circular buffer holding the messages of a sliding window, indexed by their distance to the
+ * start of the window (the oldest message not accepted yet).
+ *
+ * Inserting, looking up and moving the start of the window are O(1): the slots never move, only the index of the
+ * first one does. Slots may be empty, so messages received out of order are stored where they belong.
+ */
+template<typename T>
+class SlidingWindow {
+public:
+    explicit SlidingWindow(size_t capacity = 0) { this->reset(capacity); }
+
+    /// \brief Empty the window and change its capacity. Memory is only allocated when the capacity grows.
+    void reset(size_t capacity) {
+        this->m_slots.resize(capacity);
+        this->clear();
+    }
+    void clear() {
+        this->m_present.assign(this->m_slots.size(), false);
+        this->m_head = 0;
+        this->m_count = 0;
+    }
+
+    size_t capacity() const { return this->m_slots.size(); }
+    /// \brief Number of slots holding a value.
+    size_t count() const { return this->m_count; }
+    bool empty() const { return this->m_count == 0; }
+
+    /// \brief true if the slot at offset positions from the start of the window holds a value.
+    bool contains(size_t offset) const { return offset < this->capacity() && this->m_present[this->index(offset)]; }
+    T& operator[](size_t offset) { return this->m_slots[this->index(offset)]; }
+    const T& operator[](size_t offset) const { return this->m_slots[this->index(offset)]; }
+
+    /// \brief Store value at offset positions from the start of the window.
+    /// \return false if the offset is outside of the window or the slot already holds a value.
+    bool insert(size_t offset, T value) {
+        if (offset >= this->capacity() || this->m_present[this->index(offset)]) {
+            return false;
+        }
+        this->m_slots[this->index(offset)] = move(value);
+        this->m_present[this->index(offset)] = true;
+        this->m_count++;
+        return true;
+    }
+    /// \brief Store value right after the last slot in use, dropping the first slot if the window is full.
+    void pushBack(T value) {
+        if (this->m_count == this->capacity()) {
+            this->popFront();
+        }
+        this->insert(this->m_count, move(value));
+    }
+    /// \brief Move the start of the window to the next slot, dropping the value of the first one.
+    void popFront() {
+        if (this->m_present[this->m_head]) {
+            this->m_present[this->m_head] = false;
+            this->m_count--;
+        }
+        this->m_head = this->index(1);
+    }
+
+private:
+    vector<T> m_slots;
+    vector<bool> m_present;
+    /// \brief Slot of the start of the window.
+    size_t m_head = 0;
+    size_t m_count = 0;
+
+    size_t index(size_t offset) const {
+        size_t index = this->m_head + offset;
+        return index >= this->m_slots.size() ? index - this->m_slots.size() : index;
+    }
+};
+
+
+#endif //REDES_1_T1_SLIDINGWINDOW_H
@@ -0,0 +1,91 @@
+#ifndef REDES_1_T1_SPSCQUEUE_H
+#define REDES_1_T1_SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+/// \brief Size of a cache line, the indices of the producer and the consumer are kept apart so they don't share one.
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief Bounded lock-free queue between exactly one producer thread and one consumer thread.
+ *
+ * The slots are allocated once and reused: the producer fills the slot returned by back() in place and publishes it
+ * with push(), the consumer reads front() in place and releases it with pop(), so nothing is copied or allocated
+ * while the queue is in use (as long as the slots keep their capacity).
+ */
+template<typename T>
+class SpscQueue {
+public:
+    /// \param capacity Most values held at once, rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        this->m_slots.resize(size);
+        this->m_mask = size - 1;
+    }
+
+    size_t capacity() const { return this->m_slots.size(); }
+
+    /// \brief Producer: slot to be filled by the next push, nullptr if the queue is full.
+    T *back() {
+        size_t tail = this->m_tail.load(memory_order_relaxed);
+        if (tail - this->m_cachedHead == this->capacity()) {
+            this->m_cachedHead = this->m_head.load(memory_order_acquire);
+            if (tail - this->m_cachedHead == this->capacity()) {
+                return nullptr;
+            }
+        }
+        return &this->m_slots[tail & this->m_mask];
+    }
+    /// \brief Producer: hand the slot returned by back() to the consumer.
+    void push() {
+        // Sequentially consistent, so a consumer going to sleep either sees the value or is seen sleeping.
+        this->m_tail.store(this->m_tail.load(memory_order_relaxed) + 1, memory_order_seq_cst);
+    }
+
+    /// \brief Consumer: oldest value of the queue, nullptr if it is empty.
+    T *front() {
+        size_t head = this->m_head.load(memory_order_relaxed);
+        if (head == this->m_cachedTail) {
+            this->m_cachedTail = this->m_tail.load(memory_order_acquire);
+            if (head == this->m_cachedTail) {
+                return nullptr;
+            }
+        }
+        return &this->m_slots[head & this->m_mask];
+    }
+    /// \brief Consumer: give the slot returned by front() back to the producer.
+    void pop() {
+        this->m_head.store(this->m_head.load(memory_order_relaxed) + 1, memory_order_seq_cst);
+    }
+
+    /// \brief true if there is nothing to consume. Exact only when called by the consumer.
+    bool empty() const {
+        return this->m_head.load(memory_order_seq_cst) == this->m_tail.load(memory_order_seq_cst);
+    }
+
+private:
+    vector<T> m_slots;
+    size_t m_mask = 0;
+
+    // Padding instead of alignas, C++14 doesn't align heap allocations beyond max_align_t.
+    char m_consumerPadding[CACHE_LINE_SIZE];
+    /// \brief Next slot to be read, written only by the consumer.
+    atomic<size_t> m_head{0};
+    /// \brief Last tail seen by the consumer, saves reading the cache line of the producer for every value.
+    size_t m_cachedTail = 0;
+    char m_producerPadding[CACHE_LINE_SIZE];
+    /// \brief Next slot to be filled, written only by the producer.
+    atomic<size_t> m_tail{0};
+    /// \brief Last head seen by the producer.
+    size_t m_cachedHead = 0;
+    char m_endPadding[CACHE_LINE_SIZE];
+};
+
+
+#endif //REDES_1_T1_SPSCQUEUE_H
@@ -0,0 +1,93 @@
+#include "ThreadedTransport.h"
+
+ThreadedTransport::ThreadedTransport(unique_ptr<Transport> transport, size_t queueSize) :
+        m_transport(move(transport)), m_received(queueSize), m_toSend(queueSize) {
+    // The receiving thread only blocks for a short while, so it notices when it must stop.
+    this->m_transport->setReceiveTimeout(THREADED_POLL_INTERVAL);
+    // Frames of any size are taken from the start, the thread may already be waiting for frames when the node
+    // switches to larger ones.
+    this->m_transport->setFrameSize(this->m_transport->maxFrameSize());
+    this->m_receiver = thread(&ThreadedTransport::receiveLoop, this);
+    this->m_sender = thread(&ThreadedTransport::sendLoop, this);
+}
+
+ThreadedTransport::~ThreadedTransport() {
+    this->m_stopping = true;
+    this->m_toSendBell.ring();
+    this->m_sender.join();
+    this->m_receiver.join();
+}
+
+long ThreadedTransport::sendFrame(const C_BYTE *frame, size_t size) {
+    this->queueFrame(frame, size);
+    this->m_toSendBell.ring();
+    return static_cast<long>(size);
+}
+
+size_t ThreadedTransport::sendBatch(const FrameBatch &batch) {
+    for (size_t i = 0; i < batch.size(); i++) {
+        this->queueFrame(batch.frame(i), batch.frameSize(i));
+    }
+    this->m_toSendBell.ring();
+    return batch.size();
+}
+
+void ThreadedTransport::queueFrame(const C_BYTE *frame, size_t size) {
+    vector<C_BYTE> *slot;
+    while ((slot = this->m_toSend.back()) == nullptr) {
+        // Full: the sending thread is behind, make sure it is awake and let it run.
+        this->m_toSendBell.ring();
+        this_thread::yield();
+    }
+    // Keeps the capacity of the slot, so it only allocates the first times a slot holds a larger frame.
+    slot->assign(frame, frame + size);
+    this->m_toSend.push();
+}
+
+long ThreadedTransport::receiveFrame(C_BYTE *buffer, size_t size) {
+    return this->m_received.receiveFrame(buffer, size, this->m_receiveTimeout);
+}
+
+size_t ThreadedTransport::receiveBatch(const FrameHandler &handler, size_t maxFrames) {
+    return this->m_received.receiveBatch(handler, maxFrames, this->m_receiveTimeout);
+}
+
+void ThreadedTransport::receiveLoop() {
+    auto store = [this](const C_BYTE *frame, size_t size) {
+        if (!this->m_received.push(frame, size)) {
+            // Like a full socket buffer, the node will ask for the frame again.
+            this->m_dropped++;
+        }
+    };
+
+    while (!this->m_stopping) {
+        if (this->m_transport->receiveBatch(store, THREADED_BATCH_SIZE) > 0) {
+            this->m_received.notify();
+        }
+    }
+}
+
+void ThreadedTransport::sendLoop() {
+    FrameBatch batch;
+    auto ready = [this] { return !this->m_toSend.empty() || this->m_stopping; };
+
+    while (true) {
+        this->m_toSendBell.waitUntil(ready, chrono::steady_clock::now() +
+                                            chrono::milliseconds(THREADED_POLL_INTERVAL));
+
+        batch.clear();
+        vector<C_BYTE> *frame;
+        while (batch.size() < THREADED_BATCH_SIZE && (frame = this->m_toSend.front()) != nullptr) {
+            batch.add(*frame);
+            this->m_toSend.pop();
+        }
+
+        if (!batch.empty()) {
+            this->m_transport->sendBatch(batch);
+        }
+        else if (this->m_stopping) {
+            // Only stop once everything queued before the destructor was sent.
+            return;
+        }
+    }
+}
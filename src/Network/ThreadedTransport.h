@@ -0,0 +1,71 @@
+#ifndef REDES_1_T1_THREADEDTRANSPORT_H
+#define REDES_1_T1_THREADEDTRANSPORT_H
+
+#include <atomic>
+#include <thread>
+#include "FrameQueue.h"
+
+/// \brief Frames held by each queue, enough for the largest window of the extended header.
+#define THREADED_QUEUE_SIZE 4096
+/// \brief Most frames moved between a queue and the link at once.
+#define THREADED_BATCH_SIZE 64
+/// \brief How long the threads wait for the link or a queue before checking if they must stop, in milliseconds.
+#define THREADED_POLL_INTERVAL 20
+
+/**
+ * @brief Wraps another transport, moving frames to and from it in two threads of its own.
+ *
+ * The receiving thread drains the link continuously into a queue, so frames keep being taken from the socket while
+ * the node is busy (e.g. running a command), and the sending thread empties a second queue into the link, so sending
+ * a window or an acknowledgement never waits for the socket. Each queue has a single producer and a single consumer
+ * and is lock-free; a thread only takes a lock to sleep when its queue stays empty.
+ */
+class ThreadedTransport: public Transport {
+public:
+    /// \param transport The transport that actually moves the frames, only used by the two threads from now on.
+    /// \param queueSize Frames held by each queue, received frames are dropped when the node doesn't keep up.
+    explicit ThreadedTransport(unique_ptr<Transport> transport, size_t queueSize = THREADED_QUEUE_SIZE);
+    /// \brief Send the frames still queued, then stop both threads.
+    ~ThreadedTransport() override;
+
+    /// \brief Queue the frame to be sent, waiting only if the queue is full.
+    long sendFrame(const C_BYTE *frame, size_t size) override;
+    long receiveFrame(C_BYTE *buffer, size_t size) override;
+    void setReceiveTimeout(long milliseconds) override { m_receiveTimeout = milliseconds; }
+
+    size_t sendBatch(const FrameBatch& batch) override;
+    /// \brief Hand the queued frames to the handler straight from the queue, without copying them.
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames) override;
+
+    bool echoesOwnFrames() const override { return m_transport->echoesOwnFrames(); }
+    size_t maxFrameSize() const override { return m_transport->maxFrameSize(); }
+    /// \brief Nothing to do, the receiving thread always takes frames of up to maxFrameSize.
+    void setFrameSize(size_t) override {}
+
+    /// \brief Number of received frames dropped because the receive queue was full.
+    size_t droppedFrames() const { return m_dropped; }
+
+private:
+    unique_ptr<Transport> m_transport;
+
+    /// \brief Frames received by the receiving thread, waiting for the node.
+    FrameQueue m_received;
+    /// \brief Frames queued by the node, waiting for the sending thread.
+    SpscQueue<vector<C_BYTE>> m_toSend;
+    Doorbell m_toSendBell;
+
+    atomic<long> m_receiveTimeout{-1};
+    atomic<size_t> m_dropped{0};
+    atomic<bool> m_stopping{false};
+
+    thread m_receiver;
+    thread m_sender;
+
+    void receiveLoop();
+    void sendLoop();
+    /// \brief Copy a frame to the send queue, without waking the sending thread.
+    void queueFrame(const C_BYTE *frame, size_t size);
+};
+
+
+#endif //REDES_1_T1_THREADEDTRANSPORT_H
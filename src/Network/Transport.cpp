@@ -0,0 +1,242 @@
+#include <stdexcept>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "Transport.h"
+#include "PacketMmapTransport.h"
+#include "ConexaoRawSocket.h"
+#include "RawSocketIncludes.h"
+
+/// \brief Largest UDP datagram over IPv4.
+#define UDP_MAX_FRAME_SIZE static_cast<size_t>(65507)
+/// \brief Socket buffers asked for UDP, so a window of large frames isn't dropped (the kernel may give less).
+#define UDP_SOCKET_BUFFER_SIZE (4 * 1024 * 1024)
+
+unique_ptr<Transport> Transport::create(const string &spec) {
+    string kind = spec.substr(0, spec.find(':'));
+    string args = spec.find(':') == string::npos ? "" : spec.substr(spec.find(':') + 1);
+
+    if (kind == "raw" && !args.empty()) {
+        return SocketTransport::openRawSocket(args);
+    }
+    else if (kind == "mmap" && !args.empty()) {
+        return PacketMmapTransport::open(args);
+    }
+    else if (kind == "udp" && !args.empty()) {
+        try {
+            auto localPort = static_cast<unsigned short>(stoul(args.substr(0, args.find(':'))));
+            if (args.find(':') == string::npos) {
+                return SocketTransport::openUdpLoopback(localPort);
+            }
+            auto remotePort = static_cast<unsigned short>(stoul(args.substr(args.find(':') + 1)));
+            return SocketTransport::openUdpLoopback(localPort, remotePort);
+        }
+        catch (logic_error&) {
+            throw runtime_error("Invalid udp transport ports: " + args);
+        }
+    }
+
+    throw runtime_error("Invalid transport: " + spec +
+                        ". Expected raw:<device>, mmap:<device>, udp:<localPort>:<remotePort> or udp:<localPort>");
+}
+
+size_t Transport::sendBatch(const FrameBatch &batch) {
+    size_t sent = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (this->sendFrame(batch.frame(i), batch.frameSize(i)) == static_cast<long>(batch.frameSize(i))) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
+size_t Transport::receiveBatch(const FrameHandler &handler, size_t maxFrames) {
+    vector<C_BYTE> buffer(this->m_frameSize);
+    long received = this->receiveFrame(buffer.data(), buffer.size());
+    if (received <= 0 || maxFrames == 0) {
+        return 0;
+    }
+    handler(buffer.data(), static_cast<size_t>(received));
+    return 1;
+}
+
+size_t Transport::sendBatchTo(const FrameBatch &batch, const PeerAddress &) {
+    return this->sendBatch(batch);
+}
+
+size_t Transport::receiveBatchFrom(const PeerFrameHandler &handler, size_t maxFrames) {
+    PeerAddress peer;
+    return this->receiveBatch([&handler, &peer](const C_BYTE *frame, size_t size) {
+        handler(frame, size, peer);
+    }, maxFrames);
+}
+
+SocketTransport::~SocketTransport() {
+    close(this->m_socket);
+}
+
+long SocketTransport::sendFrame(const C_BYTE *frame, size_t size) {
+    return send(this->m_socket, frame, size, 0);
+}
+
+long SocketTransport::receiveFrame(C_BYTE *buffer, size_t size) {
+    return recv(this->m_socket, buffer, size, 0);
+}
+
+size_t SocketTransport::sendBatch(const FrameBatch &batch) {
+    return this->sendMessages(batch, nullptr);
+}
+
+size_t SocketTransport::sendBatchTo(const FrameBatch &batch, const PeerAddress &peer) {
+    // Other sockets are connected (or, for raw sockets, reach every node), subclasses may not even send with sendmmsg.
+    if (!this->m_addressed || peer.empty()) {
+        return this->sendBatch(batch);
+    }
+    return this->sendMessages(batch, &peer);
+}
+
+size_t SocketTransport::sendMessages(const FrameBatch &batch, const PeerAddress *peer) {
+    this->m_sendFrames.resize(batch.size());
+    this->m_sendMessages.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        this->m_sendFrames[i].iov_base = const_cast<C_BYTE *>(batch.frame(i));
+        this->m_sendFrames[i].iov_len = batch.frameSize(i);
+        memset(&this->m_sendMessages[i], 0, sizeof(struct mmsghdr));
+        this->m_sendMessages[i].msg_hdr.msg_iov = &this->m_sendFrames[i];
+        this->m_sendMessages[i].msg_hdr.msg_iovlen = 1;
+        if (peer != nullptr) {
+            this->m_sendMessages[i].msg_hdr.msg_name = const_cast<sockaddr_storage *>(&peer->address);
+            this->m_sendMessages[i].msg_hdr.msg_namelen = peer->size;
+        }
+    }
+
+    // sendmmsg may stop before the end of the batch (e.g. full socket buffer), so keep going from where it stopped.
+    size_t sent = 0;
+    while (sent < batch.size()) {
+        int result = sendmmsg(this->m_socket, this->m_sendMessages.data() + sent,
+                              static_cast<unsigned int>(batch.size() - sent), 0);
+        if (result <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return sent;
+}
+
+size_t SocketTransport::receiveBatch(const FrameHandler &handler, size_t maxFrames) {
+    size_t received = this->receiveMessages(maxFrames);
+    for (size_t i = 0; i < received; i++) {
+        handler(this->m_receiveBuffers.data() + i * this->m_frameSize, this->m_receiveMessages[i].msg_len);
+    }
+    return received;
+}
+
+size_t SocketTransport::receiveBatchFrom(const PeerFrameHandler &handler, size_t maxFrames) {
+    if (!this->m_addressed) {
+        return Transport::receiveBatchFrom(handler, maxFrames);
+    }
+    size_t received = this->receiveMessages(maxFrames);
+    for (size_t i = 0; i < received; i++) {
+        this->m_receivePeers[i].size = this->m_receiveMessages[i].msg_hdr.msg_namelen;
+        handler(this->m_receiveBuffers.data() + i * this->m_frameSize, this->m_receiveMessages[i].msg_len,
+                this->m_receivePeers[i]);
+    }
+    return received;
+}
+
+size_t SocketTransport::receiveMessages(size_t maxFrames) {
+    if (maxFrames == 0) {
+        return 0;
+    }
+    if (this->m_receiveMessages.size() < maxFrames) {
+        this->m_receiveFrames.resize(maxFrames);
+        this->m_receiveMessages.resize(maxFrames);
+        if (this->m_addressed) {
+            this->m_receivePeers.resize(maxFrames);
+        }
+    }
+    if (this->m_receiveBuffers.size() < maxFrames * this->m_frameSize) {
+        this->m_receiveBuffers.resize(maxFrames * this->m_frameSize);
+    }
+    for (size_t i = 0; i < maxFrames; i++) {
+        this->m_receiveFrames[i].iov_base = this->m_receiveBuffers.data() + i * this->m_frameSize;
+        this->m_receiveFrames[i].iov_len = this->m_frameSize;
+        memset(&this->m_receiveMessages[i], 0, sizeof(struct mmsghdr));
+        this->m_receiveMessages[i].msg_hdr.msg_iov = &this->m_receiveFrames[i];
+        this->m_receiveMessages[i].msg_hdr.msg_iovlen = 1;
+        if (this->m_addressed) {
+            this->m_receiveMessages[i].msg_hdr.msg_name = &this->m_receivePeers[i].address;
+            this->m_receiveMessages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        }
+    }
+
+    // MSG_WAITFORONE: block (up to the receive timeout) for the first frame, then take only what is already pending.
+    int received = recvmmsg(this->m_socket, this->m_receiveMessages.data(), static_cast<unsigned int>(maxFrames),
+                            MSG_WAITFORONE, nullptr);
+    return received <= 0 ? 0 : static_cast<size_t>(received);
+}
+
+void SocketTransport::setReceiveTimeout(long milliseconds) {
+    struct timeval tv;
+    tv.tv_sec = milliseconds / 1000;
+    tv.tv_usec = (milliseconds % 1000) * 1000;
+    setsockopt(this->m_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv);
+}
+
+size_t SocketTransport::deviceFrameSize(int socket, const string &device) {
+    struct ifreq request;
+    memset(&request, 0, sizeof(request));
+    strncpy(request.ifr_name, device.c_str(), IFNAMSIZ - 1);
+    if (ioctl(socket, SIOCGIFMTU, &request) == -1) {
+        return DEFAULT_FRAME_SIZE;
+    }
+    return min(static_cast<size_t>(request.ifr_mtu) + ETH_HLEN, EXTENDED_MAX_FRAME_SIZE);
+}
+
+unique_ptr<SocketTransport> SocketTransport::openRawSocket(const string &device) {
+    int socket = ConexaoRawSocket(device.c_str());
+    return unique_ptr<SocketTransport>(new SocketTransport(socket, device == "lo", deviceFrameSize(socket, device)));
+}
+
+unique_ptr<SocketTransport> SocketTransport::openUdpLoopback(unsigned short localPort, unsigned short remotePort) {
+    int udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (udpSocket == -1) {
+        throw runtime_error("Could not create the udp socket.");
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    address.sin_port = htons(localPort);
+    if (bind(udpSocket, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        close(udpSocket);
+        throw runtime_error("Could not bind the udp socket to port " + to_string(localPort));
+    }
+
+    int bufferSize = UDP_SOCKET_BUFFER_SIZE;
+    setsockopt(udpSocket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(udpSocket, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    // Without a remote port the socket is shared by every node that sends to it, each answered at its own port.
+    if (remotePort == 0) {
+        return unique_ptr<SocketTransport>(new SocketTransport(udpSocket, false, UDP_MAX_FRAME_SIZE, true));
+    }
+    address.sin_port = htons(remotePort);
+    if (connect(udpSocket, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        close(udpSocket);
+        throw runtime_error("Could not connect the udp socket to port " + to_string(remotePort));
+    }
+
+    return unique_ptr<SocketTransport>(new SocketTransport(udpSocket, false, UDP_MAX_FRAME_SIZE));
+}
+
+pair<unique_ptr<SocketTransport>, unique_ptr<SocketTransport>> SocketTransport::createPair() {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) == -1) {
+        throw runtime_error("Could not create the socket pair.");
+    }
+
+    return {unique_ptr<SocketTransport>(new SocketTransport(sockets[0], false, EXTENDED_MAX_FRAME_SIZE)),
+            unique_ptr<SocketTransport>(new SocketTransport(sockets[1], false, EXTENDED_MAX_FRAME_SIZE))};
+}
@@ -0,0 +1,193 @@
+#ifndef REDES_1_T1_TRANSPORT_H
+#define REDES_1_T1_TRANSPORT_H
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include "../Message/Message.h"
+
+/// \brief Called for each frame received in a batch, the frame is only valid during the call.
+typedef function<void(const C_BYTE *frame, size_t size)> FrameHandler;
+
+/**
+ * @brief The node a frame came from on a link shared by several nodes that each have an address of their own (the
+ * clients of an unconnected UDP socket), so the answers can be sent back to it.
+ *
+ * Empty on links with a single other node, and on raw sockets, whose frames reach every node of the segment and have
+ * no ethernet header to take an address from.
+ */
+struct PeerAddress {
+    sockaddr_storage address{};
+    socklen_t size = 0;
+
+    bool empty() const { return size == 0; }
+    bool operator==(const PeerAddress& other) const {
+        return size == other.size && memcmp(&address, &other.address, size) == 0;
+    }
+    bool operator!=(const PeerAddress& other) const { return !(*this == other); }
+};
+
+/// \brief Called for each frame received in a batch along with the node that sent it.
+typedef function<void(const C_BYTE *frame, size_t size, const PeerAddress& peer)> PeerFrameHandler;
+
+/**
+ * @brief Frames stored back to back in a single buffer, so a whole window can be handed to the transport at once.
+ */
+class FrameBatch {
+public:
+    /// \brief Append a frame to the end of the batch.
+    void add(const vector<C_BYTE>& frame) { this->add(frame.data(), frame.size()); }
+    void add(const C_BYTE *frame, size_t size) {
+        this->m_offsets.push_back(this->m_data.size());
+        this->m_data.insert(this->m_data.end(), frame, frame + size);
+    }
+    /// \brief Append a frame of size bytes, to be written in place at the returned address.
+    C_BYTE *append(size_t size) {
+        this->m_offsets.push_back(this->m_data.size());
+        this->m_data.resize(this->m_data.size() + size);
+        return this->m_data.data() + this->m_offsets.back();
+    }
+    /// \brief Remove all the frames, keeping the allocated memory to be reused by the next batch.
+    void clear() { this->m_data.clear(); this->m_offsets.clear(); }
+
+    size_t size() const { return this->m_offsets.size(); }
+    bool empty() const { return this->m_offsets.empty(); }
+
+    const C_BYTE *frame(size_t index) const { return this->m_data.data() + this->m_offsets[index]; }
+    size_t frameSize(size_t index) const {
+        size_t end = index + 1 < this->m_offsets.size() ? this->m_offsets[index + 1] : this->m_data.size();
+        return end - this->m_offsets[index];
+    }
+
+private:
+    vector<C_BYTE> m_data;
+    vector<size_t> m_offsets;
+};
+
+/**
+ * @brief Abstract link used by a NetworkNode to move whole frames to and from the other node.
+ *
+ * The protocol logic only needs to send and receive frames, so the concrete backend (raw socket on a network device,
+ * UDP on the loopback interface, an in-process socket pair...) can be selected at runtime.
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /// \brief Send a single frame to the other node.
+    /// \return the number of bytes sent, or -1 on error.
+    virtual long sendFrame(const C_BYTE *frame, size_t size) = 0;
+    /// \brief Receive a single frame, waiting at most the configured receive timeout.
+    /// \return the number of bytes received, or -1 on timeout or error.
+    virtual long receiveFrame(C_BYTE *buffer, size_t size) = 0;
+    /// \brief Change how long receiveFrame waits for a frame before giving up.
+    virtual void setReceiveTimeout(long milliseconds) = 0;
+
+    /// \brief Send all the frames of a batch, as a single operation if the transport supports it.
+    /// \return the number of frames sent.
+    virtual size_t sendBatch(const FrameBatch& batch);
+    /// \brief Wait for at least one frame and hand every pending frame (up to maxFrames) to the handler.
+    /// \return the number of frames handled, 0 on timeout.
+    virtual size_t receiveBatch(const FrameHandler& handler, size_t maxFrames);
+    /// \brief Send all the frames of a batch to the given node, or as sendBatch if the peer is empty.
+    /// \return the number of frames sent.
+    virtual size_t sendBatchTo(const FrameBatch& batch, const PeerAddress& peer);
+    /// \brief As receiveBatch, also telling which node sent each frame. The peers are empty unless the transport is
+    /// shared by several nodes with addresses of their own.
+    virtual size_t receiveBatchFrom(const PeerFrameHandler& handler, size_t maxFrames);
+
+    /// \brief true if the frames sent by this node are also received by it (e.g. raw socket on the lo device).
+    virtual bool echoesOwnFrames() const { return false; }
+
+    /// \brief File descriptor that becomes readable when frames arrive, so the node can sleep on it with other events.
+    /// \return -1 if the transport has none, in which case receiveBatch must do the waiting.
+    virtual int pollDescriptor() const { return -1; }
+    /// \brief true if frames were already taken from the descriptor but not handed to the node yet, so it must not
+    /// wait for the descriptor before calling receiveBatch.
+    virtual bool hasPendingFrames() const { return false; }
+
+    /// \brief Largest frame the link can carry, e.g. the MTU of the network device plus the ethernet header.
+    virtual size_t maxFrameSize() const = 0;
+    /// \brief Largest frame that will be exchanged from now on, receive buffers are sized for it.
+    virtual void setFrameSize(size_t size) { m_frameSize = size; }
+
+    /**
+     * @brief Create a transport from a textual description, allowing it to be chosen at runtime.
+     * @param spec One of:
+     *  - "raw:<device>" raw socket on a network device (needs root).
+     *  - "mmap:<device>" raw socket on a network device using PACKET_MMAP rings (needs root).
+     *  - "udp:<localPort>:<remotePort>" UDP datagrams on 127.0.0.1.
+     *  - "udp:<localPort>" UDP datagrams on 127.0.0.1 from any port, answered with sendBatchTo (see openUdpLoopback).
+     * @return The created transport, throws runtime_error if the spec is invalid or the transport can't be opened.
+     */
+    static unique_ptr<Transport> create(const string& spec);
+
+protected:
+    size_t m_frameSize = DEFAULT_FRAME_SIZE;
+};
+
+/**
+ * @brief Transport backed by a socket file descriptor, where each send/recv moves exactly one frame.
+ */
+class SocketTransport: public Transport {
+public:
+    ~SocketTransport() override;
+
+    long sendFrame(const C_BYTE *frame, size_t size) override;
+    long receiveFrame(C_BYTE *buffer, size_t size) override;
+    void setReceiveTimeout(long milliseconds) override;
+
+    /// \brief Send the whole batch with sendmmsg, a single system call for all the frames.
+    size_t sendBatch(const FrameBatch& batch) override;
+    /// \brief Receive up to maxFrames frames with a single recvmmsg, waiting only for the first one.
+    size_t receiveBatch(const FrameHandler& handler, size_t maxFrames) override;
+    size_t sendBatchTo(const FrameBatch& batch, const PeerAddress& peer) override;
+    size_t receiveBatchFrom(const PeerFrameHandler& handler, size_t maxFrames) override;
+
+    bool echoesOwnFrames() const override { return m_echoesOwnFrames; }
+    int pollDescriptor() const override { return m_socket; }
+    size_t maxFrameSize() const override { return m_maxFrameSize; }
+
+    /// \brief Open a raw socket on a network device, as given by the teacher of the course.
+    static unique_ptr<SocketTransport> openRawSocket(const string& device);
+    /// \brief Open a UDP socket bound to 127.0.0.1:localPort that sends to 127.0.0.1:remotePort. Without a remote port
+    /// the socket receives from any port, and frames can only be sent with sendBatchTo, to the port of a peer.
+    static unique_ptr<SocketTransport> openUdpLoopback(unsigned short localPort, unsigned short remotePort = 0);
+    /// \brief Create two connected in-process transports, useful to run both nodes in a single process.
+    static pair<unique_ptr<SocketTransport>, unique_ptr<SocketTransport>> createPair();
+
+protected:
+    SocketTransport(int socket, bool echoesOwnFrames, size_t maxFrameSize, bool addressed = false) :
+            m_socket(socket), m_echoesOwnFrames(echoesOwnFrames), m_maxFrameSize(maxFrameSize), m_addressed(addressed) {}
+
+    /// \brief Largest frame that can be sent through a network device (its MTU plus the ethernet header), limited
+    /// to what the extended header can describe.
+    static size_t deviceFrameSize(int socket, const string& device);
+
+    int m_socket;
+
+private:
+    bool m_echoesOwnFrames;
+    size_t m_maxFrameSize;
+    /// \brief true if the socket isn't connected, so the address of each frame tells which node sent it.
+    bool m_addressed;
+
+    /// \brief Buffers where recvmmsg writes the received frames, reused between calls.
+    vector<C_BYTE> m_receiveBuffers;
+    /// \brief sendmmsg/recvmmsg descriptors, reused between calls to avoid allocations in the hot path.
+    vector<struct iovec> m_sendFrames, m_receiveFrames;
+    vector<struct mmsghdr> m_sendMessages, m_receiveMessages;
+    /// \brief Where recvmmsg writes the sender of each frame, only used if the socket is addressed.
+    vector<PeerAddress> m_receivePeers;
+
+    /// \brief Send a batch with sendmmsg, to peer if not nullptr.
+    size_t sendMessages(const FrameBatch& batch, const PeerAddress *peer);
+    /// \brief Receive up to maxFrames frames with recvmmsg into m_receiveBuffers (and their senders into
+    /// m_receivePeers if the socket is addressed).
+    /// \return the number of frames received.
+    size_t receiveMessages(size_t maxFrames);
+};
+
+#endif //REDES_1_T1_TRANSPORT_H
@@ -1,5 +1,7 @@
 #include <memory>
+#include <sstream>
 #include "Server.h"
+#include "../FileHandler/DirectoryListing.h"
 #include "../FileHandler/fileHandler.h"
 
 void Server::sendError(const string &errorText) {
@@ -15,79 +17,75 @@ void Server::sendOk() {
 
 std::string Server::getCompletePath(const string &pathExtension) {
     if (pathExtension[0] == '/') {
-        return pathExtension;
+        return normalizePath(pathExtension);
     }
     else {
-        return this->m_currentDirectory + "/" + pathExtension;
+        lock_guard<mutex> lock(this->m_session->directoryMutex);
+        return normalizePath(this->m_session->currentDirectory + "/" + pathExtension);
     }
 }
 
 
-std::string Server::execBashCmd(const string &command) {
-    logger->info("Executing bash command: " + command);
-
-    string redirected_command = command + " 2>&1";
-
-    string result;
-    unique_ptr<FILE, decltype(&pclose)> pipe(popen(redirected_command.c_str(), "r"), pclose);
-    if (!pipe) {
-        logger->error("Command execution failed: " + command);
-        throw runtime_error("Command execution failed: " + command);
-    }
-
-    char buffer[1024];
-    while (fgets(buffer, 1024, pipe.get()) != nullptr) {
-        result += buffer;
-    }
-    logger->debug("Command result: " + result);
-    return result;
-}
-
 bool Server::handleLS() {
     logger->info("Handling a LS message");
 
-    string dirPath = this->getLongStringMessageData();
-    string arg = "";
-    auto itStart = dirPath.find(" -");
-    auto it = itStart;
-    while (it < dirPath.size() && dirPath[it] != ' ') {
-        arg += dirPath[it];
-        it++;
-    }
-
-    dirPath = dirPath.substr(it);
-
-    try {
-        string result = execBashCmd("ls "+ arg + this->getCompletePath(dirPath));
-        if (!result.empty()) {
-            this->enqueueLongStringMessageData(MessageType::LS_SHOW, 0, result);
-            this->sendSequence();
-            return true;
+    // The options of ls (e.g. -la) and a path, the current directory if there is none.
+    istringstream arguments(this->getLongStringMessageData());
+    unsigned flags = 0;
+    string argument, dirPath;
+    while (arguments >> argument) {
+        if (argument.size() > 1 && argument[0] == '-') {
+            if (!parseListOptions(argument, flags)) {
+                this->sendError("ls: unsupported option " + argument);
+                return false;
+            }
+        }
+        else {
+            dirPath = argument;
         }
     }
-    catch (runtime_error& error) {
-        this->sendError(error.what());
+
+    // The entries are sent while the directory is read, so a huge directory is neither buffered nor waited for.
+    auto lister = make_shared<DirectoryLister>(this->getCompletePath(dirPath), flags);
+    if (!lister->isOpen()) {
+        this->sendError(lister->error());
         return false;
     }
+    this->enqueueStream(MessageType::LS_SHOW, 0, [lister](char *buffer, size_t size) {
+        return lister->read(buffer, size);
+    });
+    this->sendSequence();
+    return true;
 }
 
 bool Server::handleMkdir() {
     logger->info("Handling a MKDIR message");
 
-    string dirPath = this->getLongStringMessageData();
-
-    try {
-        string result = execBashCmd("mkdir " + this->getCompletePath(dirPath));
-        if (!result.empty()) {
-            this->sendError(result);
-            return false;
+    // The directories to create, after an optional -p.
+    istringstream arguments(this->getLongStringMessageData());
+    bool parents = false;
+    vector<string> dirPaths;
+    string argument;
+    while (arguments >> argument) {
+        if (argument == "-p") {
+            parents = true;
+        }
+        else {
+            dirPaths.push_back(argument);
         }
     }
-    catch (runtime_error& error) {
-        this->sendError(error.what());
+    if (dirPaths.empty()) {
+        this->sendError("mkdir: missing operand");
         return false;
     }
 
+    for (const string& dirPath : dirPaths) {
+        pair<bool, string> result = makeDirectory(this->getCompletePath(dirPath), parents);
+        if (!result.first) {
+            this->sendError("mkdir: " + result.second);
+            return false;
+        }
+    }
     this->sendOk();
     return true;
 }
@@ -96,19 +94,16 @@ bool Server::handleCD() {
     logger->info("Handling a CD message: " + (string)this->m_receivedQueue.front());
 
     string dirPath = this->getCompletePath(this->getLongStringMessageData());
-    try {
-        string result = execBashCmd("cd " + dirPath);
-        if (!result.empty()) {
-            this->sendError(result);
-            return false;
-        }
-    }
-    catch (runtime_error& error) {
-        this->sendError(error.what());
+    pair<bool, string> result = canEnterDirectory(dirPath);
+    if (!result.first) {
+        this->sendError("cd: " + result.second);
         return false;
     }
 
-    this->m_currentDirectory = dirPath;
+    {
+        lock_guard<mutex> lock(this->m_session->directoryMutex);
+        this->m_session->currentDirectory = dirPath;
+    }
     this->sendOk();
     return true;
 }
@@ -134,11 +129,12 @@ bool Server::handlePUT() {
         this->sendError(e.what());
         return false;
     }
-    this->sendOk();
+    this->acceptFile();
 
-    this->waitSequence(false);
-
-    this->handleFileData(fileWritePath + "/" + fileName);
+    if (!this->handleFileData(fileWritePath + "/" + fileName)) {
+        this->sendError("Could not receive the whole file " + fileName + ", put it again to resume.");
+        return false;
+    }
     this->sendOk();
     return true;
 }
@@ -150,7 +146,8 @@ bool Server::handleGET() {
     this->popEndMessage();
 
     if (!fileExists(filePath)) {
-        cerr << "Get error: " << filePath << " file does not exist." << endl;
+        // The client waits for the descriptor of the file.
+        this->sendError("get: " + filePath + " does not exist.");
         return false;
     }
 
@@ -162,19 +159,44 @@ bool Server::handleGET() {
     this->m_sendQueue.emplace_back(MessageType::FILE_DESCRIPTOR, 1, fileSize);
     this->m_sendQueue.emplace_back(MessageType::END, 2);
     this->sendSequence();
-    bool result = this->waitSequence();
-    if (!result) {
+    // The client asks for a slice of the file, or for what its checkpoint is missing.
+    unsigned long start, length;
+    if (!this->waitFileAccepted(start, length)) {
         logger->info("Client recused file, cancelling send operation.");
         return false;
     }
 
-    logger->debug("Reading file: " + filePath);
-    string fileData = readFile(filePath);
-    this->enqueueLongStringMessageData(MessageType::FILE_DATA, 0, fileData);
-    logger->info("Messages to send: " + to_string(this->m_sendQueue.size()));
+    logger->debug("Streaming file: " + filePath);
+    if (!this->enqueueFile(MessageType::FILE_DATA, 0, filePath, start, length)) {
+        // The descriptor was already accepted, so the other node still waits for the data.
+        logger->error("Could not open file: " + filePath);
+        this->enqueueLongStringMessageData(MessageType::FILE_DATA, 0, "");
+    }
+    logger->info("Bytes to send: " + to_string(min(length, fileSize - min(start, fileSize))) + " from byte " +
+                 to_string(start));
     this->sendSequence();
 
     logger->info("Full file sent.");
 
     return true;
 }
+
+bool Server::handleGlob() {
+    logger->info("Handling a GLOB message");
+
+    istringstream patterns(this->getLongStringMessageData());
+    string pattern, files;
+    while (getline(patterns, pattern)) {
+        for (const string& file : matchFiles(this->getCompletePath(pattern))) {
+            files += file + "\n";
+        }
+    }
+
+    if (files.empty()) {
+        this->sendError("No files match " + patterns.str());
+        return false;
+    }
+    this->enqueueLongStringMessageData(MessageType::LS_SHOW, 0, files);
+    this->sendSequence();
+    return true;
+}
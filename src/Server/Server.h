@@ -2,14 +2,34 @@
 #define REDES_1_T1_SERVER_H
 
 
+#include <mutex>
+#include "../FileHandler/ChunkStore.h"
 #include "../Network/NetworkNode.h"
 
+/**
+ * @brief State shared by the servers of every channel of a multiplexed link, so a 'cd' on one channel also applies
+ * to the commands of the others. Each client of a server shared by several clients (SessionMux) has its own.
+ */
+struct ServerSession {
+    mutex directoryMutex;
+    string currentDirectory = "/";
+    /// \brief Chunks of the files put by the client, nullptr to receive whole files.
+    shared_ptr<ChunkStore> chunkStore;
+};
+
 /**
  * @brief The server side of the connection, which handles messages send from the client.
  */
 class Server: public NetworkNode {
     using NetworkNode::NetworkNode;
 
+public:
+    /// \brief Create a server that shares its session with the servers of the other channels of the link.
+    Server(unique_ptr<Transport> transport, shared_ptr<ServerSession> session)
+        : NetworkNode(move(transport)), m_session(move(session)) {
+        this->setChunkStore(this->m_session->chunkStore);
+    }
+
 protected:
     /// \brief Handle a 'ls' command from the client, sending it the list of files in the current directoy.
     /// \return true if the execution was successfull, false otherwise.
@@ -26,6 +46,10 @@ protected:
     /// \brief Handle a 'get' command from the client, sending it a file.
     /// \return true if the execution was successfull, false otherwise.
     bool handleGET() override;
+    /// \brief Handle a 'glob' message from the client, sending it the files that match the patterns (one per line),
+    /// relative to the current directory.
+    /// \return true if any file matched, false otherwise.
+    bool handleGlob() override;
 
 private:
     /// \brief Send a execution error to the client.
@@ -35,12 +59,10 @@ private:
     /// \brief Send a execution success to the client.
     void sendOk();
 
-    /// \brief executes a command in the server bash.
-    std::string execBashCmd(const string& command);
-
+    /// \brief The absolute path of a path relative to the current directory, normalized by normalizePath.
     std::string getCompletePath(const string& pathExtension);
 
-    string m_currentDirectory = "/";
+    shared_ptr<ServerSession> m_session = make_shared<ServerSession>();
 
     // TODO: used for debugging. Remove this.
     int m_debugCounter = 1;
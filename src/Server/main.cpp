@@ -1,15 +1,103 @@
 #include "Server.h"
+#include "../Network/ChannelMux.h"
+#include "../Network/SessionMux.h"
+#include "../Network/ThreadedTransport.h"
 #include <iostream>
 
-int main() {
+int main(int argc, char *argv[]) {
     Logger::setLevel(LoggerLevel::INFO);
 
-    std::cout << "Starting server." << std::endl;
-    Server server;
+    // The link options are proposed by the client when it starts.
+    string transport = DEFAULT_TRANSPORT;
+    bool threaded = false;
+    bool multiplexed = false;
+    bool shared = false;
+    string chunkStore;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threaded") {
+            threaded = true;
+        }
+        else if (arg == "--channels") {
+            multiplexed = true;
+        }
+        else if (arg == "--sessions") {
+            shared = true;
+        }
+        else if (arg.compare(0, 14, "--chunk-store=") == 0) {
+            chunkStore = arg.substr(14);
+        }
+        else {
+            transport = arg;
+        }
+    }
+
+    if (shared && multiplexed) {
+        std::cerr << "--sessions and --channels can't be used together." << std::endl;
+        return 1;
+    }
 
-    if (DEVICE == "lo") {
+    std::cout << "Starting server." << std::endl;
+    unique_ptr<Transport> link = Transport::create(transport);
+    // Read by every node, so set before the muxes start their threads.
+    NetworkNode::echo_transport = link->echoesOwnFrames();
+    if (NetworkNode::echo_transport) {
         NetworkNode::message_delimiter = BEGIN_DELIMITER;
     }
+    // The session mux already reads the link in a thread of its own, and must know where each frame came from.
+    if (threaded && !shared) {
+        link.reset(new ThreadedTransport(move(link)));
+    }
+
+    auto session = make_shared<ServerSession>();
+    if (!chunkStore.empty()) {
+        session->chunkStore = make_shared<ChunkStore>(chunkStore);
+    }
+
+    // Each client gets a server with a session (current directory) and a thread of its own, the chunk store is shared.
+    if (shared) {
+        SessionMux clients(move(link));
+        clients.accept([session](unique_ptr<Transport> transport, uint32_t id) {
+            thread([session, id](unique_ptr<Transport> transport) {
+                auto clientSession = make_shared<ServerSession>();
+                clientSession->chunkStore = session->chunkStore;
+                Server server(move(transport), clientSession);
+                Logger::getInstance()->info("Serving the client of session " + to_string(id) + ".");
+                try {
+                    while (true) {
+                        server.waitSequence();
+                    }
+                }
+                catch (SessionExpired& expired) {
+                    Logger::getInstance()->info(expired.what());
+                }
+            }, move(transport)).detach();
+        });
+        while (true) {
+            this_thread::sleep_for(chrono::hours(1));
+        }
+    }
+
+    // Channel 0 is served here, each channel opened by the client gets a server and a thread of its own.
+    unique_ptr<ChannelMux> channels;
+    if (multiplexed) {
+        channels.reset(new ChannelMux(move(link)));
+        link = channels->open(0);
+        channels->accept([session](unique_ptr<Transport> channel) {
+            thread([session](unique_ptr<Transport> channel) {
+                Server server(move(channel), session);
+                try {
+                    while (true) {
+                        server.waitSequence();
+                    }
+                }
+                catch (ChannelClosed& closed) {
+                    Logger::getInstance()->info(closed.what());
+                }
+            }, move(channel)).detach();
+        });
+    }
+    Server server(move(link), session);
 
     while (true) {
         server.waitSequence();